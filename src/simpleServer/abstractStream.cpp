@@ -1,6 +1,12 @@
 #include "abstractStream.h"
 
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <vector>
+
+#include "exceptions.h"
 
 
 namespace simpleServer {
@@ -106,6 +112,119 @@ bool simpleServer::IGeneralStream::isEof(const BinaryView& buffer) {
 	return buffer.data == eofConst.data;
 }
 
+std::size_t IGeneralStream::implWriteVector(const BinaryView *buffers, std::size_t count, bool nonblock) {
+	std::size_t written = 0;
+	for (std::size_t i = 0; i < count; i++) {
+		if (buffers[i].empty()) continue;
+		//block only for the first byte
+		BinaryView r = implWrite(buffers[i], nonblock || written != 0);
+		if (isEof(r)) return written?written:eofWritten;
+		written += buffers[i].length - r.length;
+		if (!r.empty()) break;
+	}
+	return written;
+}
+
+std::size_t AbstractStream::writeVector(const BinaryView *buffers, std::size_t count, WriteMode wrmode) {
+	std::size_t total = 0;
+	for (std::size_t i = 0; i < count; i++) total += buffers[i].length;
+
+	//small data are collected in the buffer
+	if (total <= wrBuff.remain()) {
+		for (std::size_t i = 0; i < count; i++) {
+			if (buffers[i].empty()) continue;
+			copydata(wrBuff.ptr+wrBuff.wrpos, buffers[i].data, buffers[i].length);
+			wrBuff.wrpos += buffers[i].length;
+		}
+		if (wrmode == writeAndFlush && !flush(writeAndFlush)) return eofWritten;
+		return total;
+	}
+
+	//content of the buffer goes first, followed by the buffers
+	static const std::size_t localParts = 8;
+	BinaryView localBuff[localParts];
+	std::vector<BinaryView> extBuff;
+	BinaryView *parts = localBuff;
+	if (count >= localParts) {
+		extBuff.resize(count+1);
+		parts = extBuff.data();
+	}
+	parts[0] = wrBuff.getView();
+	std::copy(buffers, buffers+count, parts+1);
+
+	std::size_t first = 0, end = count+1;
+	std::size_t pending = wrBuff.wrpos;
+	std::size_t written = 0;
+	bool rep = (wrmode == writeWholeBuffer || wrmode == writeAndFlush);
+	bool eof = false;
+	do {
+		while (first < end && parts[first].empty()) first++;
+		if (first == end) break;
+		std::size_t r = implWriteVector(parts+first, end-first, wrmode == writeNonBlock);
+		if (r == eofWritten) {
+			eof = true;
+			break;
+		}
+		std::size_t fromBuff = std::min(r, pending);
+		pending -= fromBuff;
+		written += r - fromBuff;
+		while (r) {
+			std::size_t l = std::min(r, parts[first].length);
+			parts[first] = parts[first].substr(l);
+			r -= l;
+			if (parts[first].empty()) first++;
+		}
+	} while (rep);
+
+	//unsent part of the buffer is moved to the beginning
+	if (pending) copydata(wrBuff.ptr, wrBuff.ptr+wrBuff.wrpos-pending, pending);
+	wrBuff.wrpos = pending;
+	if (eof) return eofWritten;
+	if (wrmode == writeAndFlush && !implFlush()) return eofWritten;
+	return written;
+}
+
+std::size_t IGeneralStream::implSendFile(int , std::size_t , std::size_t , bool ) {
+	throw std::runtime_error("Stream cannot send a file directly");
+}
+
+std::size_t AbstractStream::sendFile(int fd, std::size_t offset, std::size_t size, WriteMode wrmode) {
+	bool rep = (wrmode == writeWholeBuffer || wrmode == writeAndFlush);
+	std::size_t written = 0;
+	if (canSendFile()) {
+		//buffered data must be sent before the file
+		if (!flush(rep?writeWholeBuffer:wrmode)) return eofWritten;
+		if (wrBuff.wrpos) return 0;
+		while (written < size) {
+			std::size_t r = implSendFile(fd, offset+written, size-written, wrmode == writeNonBlock);
+			if (r == eofWritten) return eofWritten;
+			if (r == 0) break;
+			written += r;
+			if (!rep) break;
+		}
+	} else {
+		//read the file directly to the output buffer
+		while (written < size) {
+			if (wrBuff.remain() == 0) {
+				if (!implWrite(wrBuff, wrmode == writeNonBlock)) return eofWritten;
+				if (wrBuff.remain() == 0) break;
+			}
+			ssize_t r = pread(fd, wrBuff.ptr+wrBuff.wrpos, std::min(wrBuff.remain(), size-written), offset+written);
+			if (r < 0) {
+				int e = errno;
+				if (e == EINTR) continue;
+				throw SystemException(e, __FUNCTION__);
+			}
+			if (r == 0) break;
+			wrBuff.wrpos += r;
+			written += r;
+			if (!rep) break;
+		}
+	}
+	if (wrmode == writeAndFlush && !flush(writeAndFlush)) return eofWritten;
+	return written;
+}
+
 AsyncProvider simpleServer::AbstractStream::setAsyncProvider( AsyncProvider asyncProvider) {
 	std::swap(this->asyncProvider, asyncProvider);
 	return asyncProvider;
@@ -115,6 +234,10 @@ bool AbstractStream::canRunAsync() const {
 	return asyncProvider != nullptr;
 }
 
+bool AbstractStream::canSendFile() const {
+	return false;
+}
+
 void AbstractStream::copydata(unsigned char *target, const unsigned char *source, std::size_t count){
 	std::memmove(target,source,count);
 }
@@ -84,6 +84,9 @@ public:
 	 */
 	static bool isEof(const BinaryView &buffer);
 
+	///Value returned by vectored write when EOF has been reached (connection reset)
+	static const std::size_t eofWritten = static_cast<std::size_t>(-1);
+
 
 	///Changes timeout for all blocking operations
 	/**
@@ -154,6 +157,39 @@ protected:
 	 */
 	virtual bool implWrite(WrBuffer &curBuffer, bool nonblock) = 0;
 
+	///Write multiple buffers to the stream (scatter-gather write)
+	/**
+	 * @param buffers array of buffers
+	 * @param count count of buffers in the array
+	 * @param nonblock specify true and function can return immediately if nonblocking operation
+	 * cannot be performed. Otherwise function can block to write at-least one byte
+	 *
+	 * @return count of bytes written, counted through all buffers in the order. Function
+	 * returns eofWritten, if EOF is reached.
+	 *
+	 * Default implementation writes buffers one by one through implWrite(). Streams which are
+	 * able to pass all buffers to the kernel by a single call should override this function
+	 *
+	 * @note this function doesn't provide buffering.
+	 */
+	virtual std::size_t implWriteVector(const BinaryView *buffers, std::size_t count, bool nonblock);
+
+	///Send content of a file to the stream without copying it to the user space
+	/**
+	 * @param fd descriptor of the file
+	 * @param offset offset in the file where to start
+	 * @param size count of bytes to send
+	 * @param nonblock specify true and function can return immediately if nonblocking operation
+	 * cannot be performed. Otherwise function can block to send at-least one byte
+	 *
+	 * @return count of bytes sent, 0 if end of file has been reached, or eofWritten if EOF
+	 * of the stream has been reached.
+	 *
+	 * Function is called only if canSendFile() returns true. Default implementation
+	 * throws an exception
+	 */
+	virtual std::size_t implSendFile(int fd, std::size_t offset, std::size_t size, bool nonblock);
+
 	///Read to the buffer asynchronoysly
 	/**
 	 * @param cb callback function
@@ -226,6 +262,9 @@ protected:
 		BinaryView write(BinaryView buffer, bool nonblock) {
 			return owner.implWrite(buffer,nonblock);
 		}
+		std::size_t writeVector(const BinaryView *buffers, std::size_t count, bool nonblock) {
+			return owner.implWriteVector(buffers, count, nonblock);
+		}
 		void writeAsync(const BinaryView &data, Callback &&cb) {
 			return owner.implWriteAsync(data,std::move(cb));
 		}
@@ -370,6 +409,21 @@ public:
 	}
 
 
+	///Writes multiple blocks of bytes
+	/**
+	 * @param buffers array of buffers to write
+	 * @param count count of buffers in the array
+	 * @param wrmode specify write mode
+	 * @return count of bytes written from the buffers. In modes writeWholeBuffer and writeAndFlush,
+	 * this is always total length of all buffers. If the function returns eofWritten, the
+	 * peer connection has been reset.
+	 *
+	 * Function sends content of the output buffer followed by the buffers. Small data are
+	 * collected in the output buffer as write() does. Larger data are passed to the stream
+	 * by single vectored write without copying them into the output buffer.
+	 */
+	std::size_t writeVector(const BinaryView *buffers, std::size_t count, WriteMode wrmode = writeWholeBuffer);
+
 	///write one byte to the output stream.
 	/**
 	 * @param b byte to write. note that writes are buffered, so you will need to call flush()
@@ -464,6 +518,28 @@ public:
 	 */
 	virtual bool canRunAsync() const;
 
+	///Returns true, if the stream can send a file without copying it to the user space
+	/**
+	 * @retval true sendFile() passes the file to the kernel directly (for example using sendfile())
+	 * @retval false sendFile() reads the file to the output buffer
+	 */
+	virtual bool canSendFile() const;
+
+	///Sends content of a file to the stream
+	/**
+	 * @param fd descriptor of an opened file
+	 * @param offset offset in the file where to start
+	 * @param size count of bytes to send
+	 * @param wrmode write mode
+	 * @return count of bytes sent. It can be less than requested, if the file is shorter, or
+	 * if the write mode allows to write less bytes. If the function returns eofWritten,
+	 * the peer connection has been reset.
+	 *
+	 * If the stream supports it (see canSendFile()), the file is transfered by the kernel
+	 * directly (zero-copy). Otherwise, the file is read to the output buffer.
+	 */
+	std::size_t sendFile(int fd, std::size_t offset, std::size_t size, WriteMode wrmode = writeWholeBuffer);
+
 
 	AsyncProvider getAsyncProvider() const {return asyncProvider;}
 
@@ -747,6 +823,9 @@ public:
 	BinaryView write(const BinaryView &buffer, WriteMode wrmode = writeWholeBuffer) const {
 		return (*this)->write(buffer, wrmode);
 	}
+	std::size_t writeVector(const BinaryView *buffers, std::size_t count, WriteMode wrmode = writeWholeBuffer) const {
+		return (*this)->writeVector(buffers, count, wrmode);
+	}
 	int setIOTimeout(int timeoutms) const {
 		return (*this)->setIOTimeout(timeoutms);
 	}
@@ -781,6 +860,12 @@ public:
 	bool canRunAsync() const {
 		return (*this)->canRunAsync();
 	}
+	bool canSendFile() const {
+		return (*this)->canSendFile();
+	}
+	std::size_t sendFile(int fd, std::size_t offset, std::size_t size, WriteMode wrmode = writeWholeBuffer) const {
+		return (*this)->sendFile(fd, offset, size, wrmode);
+	}
 
 	const Stream &operator << (StrViewA text) const {
 		write(BinaryView(text));
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cerrno>
+#include <cstddef>
 #include <functional>
 
 #include "shared/refcnt.h"
@@ -67,6 +69,19 @@ public:
 	 */
 	virtual void runAsync(CustomFn &&completion) = 0;
 
+	///Runs function asynchronously after specified delay
+	/**
+	 * @param ms delay in milliseconds
+	 * @param completion user function to run in completion thread
+	 *
+	 * Timers are kept inside of dispatchers, so they don't need a thread per timer. The function
+	 * is never called before the delay elapses, but it can be called later when the
+	 * completion threads are busy.
+	 *
+	 * @note If the provider is stopped before the delay elapses, the function is called immediately
+	 */
+	virtual void runAfter(int ms, CustomFn &&completion) = 0;
+
 	///Cancels waiting for asynchronous resource
 	/**
 	 * @param resource resource to cancel waiting
@@ -80,6 +95,53 @@ public:
 	 */
 	virtual void cancel(const AsyncResource &resource) = 0;
 
+	///I/O operation which can be performed directly by the provider
+	enum IOOperation {
+		///receive data from the socket
+		ioRecv,
+		///send data to the socket
+		ioSend,
+		///accept connection on the listening socket
+		/** The buffer receives address of the peer. The result is the descriptor of
+		 * the connection, which is non-blocking */
+		ioAccept
+	};
+
+	///Declaration of completion function of the direct I/O operation
+	/**
+	 * @param AsyncState reason of completion. The state asyncOK means, that the operation has been
+	 * performed
+	 * @param int result of the operation - count of transferred bytes, or descriptor of the
+	 * accepted connection. Negative value is an error code (-errno). The value ioReady means,
+	 * that the operation was not performed, but the resource is ready, so the caller should
+	 * perform it now.
+	 */
+	typedef std::function<void(AsyncState, int) > IOCompletionFn;
+
+	///Result of the direct I/O operation which means, that the caller should perform the operation
+	static const int ioReady = -EAGAIN;
+
+	///Performs I/O operation directly
+	/**
+	 * Some providers are able to perform the I/O operation in the kernel without waiting for
+	 * readiness of the resource. This saves one system call per operation.
+	 *
+	 * @param op operation
+	 * @param resource resource. The operation is part of the resource, so it can be canceled
+	 * by the function cancel()
+	 * @param buffer buffer for the operation. It must stay valid until the completion function
+	 * is called
+	 * @param size size of the buffer
+	 * @param timeout timeout in milliseconds
+	 * @param complfn completion function
+	 * @retval true operation started, the completion function will be called
+	 * @retval false the provider is not able to perform the operation directly. The completion
+	 * function has not been moved, and the caller should use runAsync() instead
+	 */
+	virtual bool runAsyncIO(IOOperation op, const AsyncResource &resource, void *buffer, std::size_t size, int timeout, IOCompletionFn &&complfn) {
+		return false;
+	}
+
 	///Stops the asynchronous provider
 	/** cancels all waiting I/O operations and stops threads. You need to call this function if you
 	 * need to stop all I/O operations before the object is destroyed
@@ -113,6 +175,11 @@ public:
 		(*this)->runAsync(std::forward<Fn>(completion));
 	}
 
+	template<typename Fn>
+	void runAfter(int ms, Fn &&completion) const {
+		(*this)->runAfter(ms, std::forward<Fn>(completion));
+	}
+
 	void stop() const {
 		(*this)->stop();
 	}
@@ -166,8 +233,39 @@ public:
 	virtual unsigned int getPendingCount() const = 0;
 
 
+	///Selects implementation of the dispatcher
+	/** Not every backend is available on every platform. If the requested backend is
+	 * not available, the platform default is used instead
+	 */
+	enum Backend {
+		///platform default
+		backendDefault,
+		///classic poll() - rebuilds the list of descriptors on every wakeup
+		backendPoll,
+		///epoll - level triggered
+		backendEpoll,
+		///epoll - edge triggered
+		/** The consumer must read (or write) the descriptor until EAGAIN before it registers
+		 * the next asynchronous operation, otherwise the operation can wait for the next edge
+		 */
+		backendEpollEdge,
+		///io_uring - supports direct I/O operations (see runAsyncIO())
+		/** Submissions and completions are processed in batches. Falls back to epoll when
+		 * the kernel doesn't support io_uring
+		 */
+		backendIoUring
+	};
+
 	///Creates platform depend StreamEventDispatcher for AsyncResource
 	static RefCntPtr<AbstractStreamEventDispatcher> create();
+	///Creates StreamEventDispatcher using specified backend
+	static RefCntPtr<AbstractStreamEventDispatcher> create(Backend backend);
+
+	///Changes backend used by the function create() without arguments
+	/**
+	 * @param backend new default backend. Affects only newly created dispatchers
+	 */
+	static void setDefaultBackend(Backend backend);
 };
 
 typedef RefCntPtr<AbstractStreamEventDispatcher> PStreamEventDispatcher;
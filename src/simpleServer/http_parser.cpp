@@ -1,12 +1,15 @@
 #include <sstream>
-#include <fstream>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <cstring>
 #include "http_parser.h"
 
 #include <fcntl.h>
 #include <string.h>
+#include <algorithm>
 #include <chrono>
+#include <limits>
+#include <vector>
 
 #include <cstdlib>
 
@@ -306,9 +309,8 @@ void HTTPRequestData::sendResponse(StrViewA contentType, BinaryView body,
 	sendResponseLine(statusCode, statusMessage);
 	Stream s = sendHeaders(statusCode,nullptr, &contentType, &body.length);
 
-	s.write(BinaryView(body));
-
-	s.flush();
+	//headers and body are sent together
+	s.writeVector(&body, 1, writeAndFlush);
 
 }
 
@@ -363,8 +365,8 @@ Stream HTTPRequestData::sendResponse(StrViewA contentType, int statusCode,
 void HTTPRequestData::sendResponse(const HTTPResponse& resp, StrViewA body) {
 	sendResponseLine(resp.getCode(), resp.getStatusMessage());
 	Stream s = sendHeaders(resp.getCode(), &resp, nullptr, &body.length);
-	s.write(BinaryView(body));
-	s.flush();
+	BinaryView b(body);
+	s.writeVector(&b, 1, writeAndFlush);
 
 
 }
@@ -799,12 +801,131 @@ static std::pair<StrViewA, StrViewA> mimeTypes[] = {
        {"ods","application/vnd.oasis.opendocument.spreadsheet"}
 };
 
+namespace {
+struct FileRange {
+	std::size_t offset;
+	std::size_t length;
+};
+}
+
+///Maximum count of ranges in single request. Requests with more ranges receive whole file
+static const std::size_t maxByteRanges = 16;
+
+static std::size_t parseRangeNumber(StrViewA str, bool &ok) {
+	std::size_t n = 0;
+	ok = !str.empty();
+	for (char c: str) {
+		if (!isdigit(c)) {
+			ok = false;
+			return 0;
+		}
+		std::size_t d = c - '0';
+		//saturate, such large position is beyond the end of any file
+		if (n > (std::numeric_limits<std::size_t>::max() - d) / 10) n = std::numeric_limits<std::size_t>::max();
+		else n = n * 10 + d;
+	}
+	return n;
+}
+
+///Parses value of the header Range
+/**
+ * @param hdr value of the header
+ * @param size size of the file
+ * @param ranges satisfiable ranges are stored here
+ * @retval true header is valid. If the ranges are empty, nothing is satisfiable (416)
+ * @retval false header is invalid or unsupported, it must be ignored
+ */
+static bool parseByteRanges(StrViewA hdr, std::size_t size, std::vector<FileRange> &ranges) {
+	hdr = hdr.trim(&isspace);
+	StrViewA unit("bytes=");
+	if (hdr.substr(0,unit.length) != unit) return false;
+	auto spl = hdr.substr(unit.length).split(",");
+	while (!!spl) {
+		StrViewA spec = spl().trim(&isspace);
+		if (spec.empty()) continue;
+		auto sep = spec.indexOf("-");
+		if (sep == spec.npos) return false;
+		StrViewA first = spec.substr(0,sep).trim(&isspace);
+		StrViewA last = spec.substr(sep+1).trim(&isspace);
+		bool ok;
+		if (first.empty()) {
+			//suffix range: last n bytes
+			std::size_t n = parseRangeNumber(last, ok);
+			if (!ok) return false;
+			if (n == 0 || size == 0) continue;
+			n = std::min(n, size);
+			ranges.push_back(FileRange{size - n, n});
+		} else {
+			std::size_t b = parseRangeNumber(first, ok);
+			if (!ok) return false;
+			std::size_t e = size ? size - 1 : 0;
+			if (!last.empty()) {
+				std::size_t l = parseRangeNumber(last, ok);
+				if (!ok || l < b) return false;
+				e = std::min(e, l);
+			}
+			if (b >= size) continue;
+			ranges.push_back(FileRange{b, e - b + 1});
+		}
+		if (ranges.size() > maxByteRanges) return false;
+	}
+	return true;
+}
+
+///Sends response 206 with requested parts of the file
+static void sendFileRanges(HTTPRequestData &req, int fd, std::size_t size, StrViewA contentType, const HTTPResponse &hdrs, const std::vector<FileRange> &ranges) {
+	HTTPResponse resp(206);
+	hdrs.forEach([&](StrViewA key, StrViewA value) {
+		resp(key, value);
+	});
+	if (ranges.size() == 1) {
+		const FileRange &r = ranges[0];
+		std::ostringstream cr;
+		cr << "bytes " << r.offset << "-" << (r.offset + r.length - 1) << "/" << size;
+		resp("Content-Range", cr.str());
+		resp.contentType(contentType);
+		resp.contentLength(r.length);
+		Stream out = req.sendResponse(resp);
+		out.sendFile(fd, r.offset, r.length, writeAndFlush);
+		return;
+	}
+
+	//multipart/byteranges - headers of the parts are prepared first to calculate length
+	std::ostringstream boundary;
+	boundary << "SSRANGE" << std::hex << std::chrono::steady_clock::now().time_since_epoch().count();
+	std::string bnd = boundary.str();
+	std::vector<std::string> partHdrs;
+	std::size_t total = 0;
+	for (auto &&r : ranges) {
+		std::ostringstream ph;
+		ph << CRLF << "--" << bnd << CRLF
+		   << CONTENT_TYPE << ": " << contentType << CRLF
+		   << "Content-Range: bytes " << r.offset << "-" << (r.offset + r.length - 1) << "/" << size << CRLF
+		   << CRLF;
+		partHdrs.push_back(ph.str());
+		total += partHdrs.back().length() + r.length;
+	}
+	std::string trailer = std::string(CRLF) + "--" + bnd + "--" + CRLF;
+	total += trailer.length();
+
+	resp.contentType(std::string("multipart/byteranges; boundary=") + bnd);
+	resp.contentLength(total);
+	Stream out = req.sendResponse(resp);
+	for (std::size_t i = 0; i < ranges.size(); i++) {
+		out.write(BinaryView(StrViewA(partHdrs[i])));
+		out.sendFile(fd, ranges[i].offset, ranges[i].length);
+	}
+	out.write(BinaryView(StrViewA(trailer)));
+	out.flush();
+}
+
 bool HTTPRequestData::sendFile(StrViewA content_type,StrViewA pathname, bool etag, std::size_t cache_secs) {
 	char *fname = (char *)alloca(pathname.length+1);
 	std::memcpy(fname, pathname.data, pathname.length);
 	fname[pathname.length] = 0;
 
 	HTTPResponse resp(200);
+	StrViewA curEtag;
 
 	if (content_type.empty()) {
 		auto pos = pathname.lastIndexOf(".");
@@ -840,7 +961,7 @@ bool HTTPRequestData::sendFile(StrViewA content_type,StrViewA pathname, bool eta
 			}
 			*p++='"';
 			*p = 0;
-			StrViewA curEtag(hexBuff, p-hexBuff);
+			curEtag = StrViewA(hexBuff, p-hexBuff);
 			HeaderValue prevEtags = (*this)["If-None-Match"];
 			auto spl = prevEtags.split(",");
 			while (spl) {
@@ -856,36 +977,45 @@ bool HTTPRequestData::sendFile(StrViewA content_type,StrViewA pathname, bool eta
 		}
 	}
 
-	std::fstream file(fname, std::ios::binary | std::ios::in );
-	if (!file) {
+	int fd = ::open(fname, O_RDONLY|O_CLOEXEC);
+	if (fd < 0) {
 		return false;
 	} else {
-		file.seekg(0,std::ios::end);
-		std::size_t sz = file.tellg();
-		if (sz == 0) {
+		struct stat st;
+		if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+			sendErrorPage(403);
+		} else if (st.st_size == 0) {
 			sendErrorPage(204);
 		} else {
-			unsigned char buff[4096];
-			file.seekg(0,std::ios::beg);
-			int p = file.get();
-			if (p == EOF) {
-				sendErrorPage(403);
-			} else{
-				file.putback(p);
-				resp.contentLength(sz);
-				resp.contentType(content_type);
-				Stream out = sendResponse(resp);
-
-				while (sz && !(!file)) {
-					file.read(reinterpret_cast<char *>(buff),4096);
-					std::size_t cnt = std::min<std::size_t>(sz,file.gcount());
-					out.write(BinaryView(buff, cnt),writeWholeBuffer);
-					sz -= cnt;
+			std::size_t sz = st.st_size;
+			std::vector<FileRange> ranges;
+			//Range is applied only when If-Range matches current version of the file
+			HeaderValue ifRange = (*this)["If-Range"];
+			HeaderValue range = (*this)["Range"];
+			bool useRange = range.defined() && method == "GET"
+					&& (!ifRange.defined() || (!curEtag.empty() && ifRange.trim(&isspace) == curEtag))
+					&& parseByteRanges(range, sz, ranges);
+			resp("Accept-Ranges","bytes");
+			try {
+				if (!useRange) {
+					resp.contentLength(sz);
+					resp.contentType(content_type);
+					Stream out = sendResponse(resp);
+					//zero-copy if the stream allows it, otherwise the file is read to the output buffer
+					out.sendFile(fd, 0, sz, writeAndFlush);
+				} else if (ranges.empty()) {
+					std::string cr("bytes */");
+					cr.append(std::to_string(sz));
+					sendResponse(HTTPResponse(416)("Content-Range",cr).contentLength(0));
+				} else {
+					sendFileRanges(*this, fd, sz, content_type, resp, ranges);
 				}
-				out.flush();
+			} catch (...) {
+				::close(fd);
+				throw;
 			}
 		}
-
+		::close(fd);
 	}
 	return true;
 }
@@ -7,8 +7,10 @@
 
 #include "http_server.h"
 
+#include <sched.h>
 #include <thread>
 
+#include "singleThreadAsync.h"
 #include "threadPoolAsync.h"
 
 
@@ -60,8 +62,61 @@ MiniHttpServer::MiniHttpServer(StreamFactory sf, AsyncProvider asyncProvider)
 	counters = srv->getCounters();
 }
 
+///Returns list of CPUs available for the process
+static std::vector<int> getAvailableCPUs() {
+	std::vector<int> out;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (int i = 0; i < CPU_SETSIZE; i++) {
+			if (CPU_ISSET(i, &set)) out.push_back(i);
+		}
+	}
+	if (out.empty()) {
+		unsigned int cnt = std::thread::hardware_concurrency();
+		for (unsigned int i = 0; i < cnt; i++) out.push_back(static_cast<int>(i));
+	}
+	if (out.empty()) out.push_back(0);
+	return out;
+}
+
+static std::vector<RefCntPtr<_intr::MiniServerImpl> > initCores(NetAddr port, const MiniHttpServer::ThreadPerCore &mode) {
+	std::vector<int> cpus = getAvailableCPUs();
+	unsigned int count = mode.cores?mode.cores:static_cast<unsigned int>(cpus.size());
+	//SO_INCOMING_CPU uses index of the shard as CPU number
+	bool incomingCpu = mode.pinThreads;
+	for (unsigned int i = 0; i < count && incomingCpu; i++) {
+		incomingCpu = cpus[i % cpus.size()] == static_cast<int>(i);
+	}
+	std::vector<StreamFactory> shards = TCPListen::createSharded(port, count, -1, 30000, incomingCpu);
+	PHTTPCounters counters = new HTTPCounters;
+	std::vector<RefCntPtr<_intr::MiniServerImpl> > out;
+	for (unsigned int i = 0; i < count; i++) {
+		RefCntPtr<_intr::MiniServerImpl> srv = new _intr::MiniServerImpl;
+		srv->setAp(SingleThreadAsync::create(mode.pinThreads?cpus[i % cpus.size()]:-1));
+		srv->setSf(shards[i]);
+		srv->setCounters(counters);
+		out.push_back(srv);
+	}
+	return out;
+}
+
+MiniHttpServer::MiniHttpServer(NetAddr port, const ThreadPerCore &mode)
+:MiniHttpServer(initCores(port, mode))
+{
+}
+
+MiniHttpServer::MiniHttpServer(Cores &&cores)
+:srv(cores[0]), cores(std::move(cores)), onError(srv->ehndl), preHandler(srv->preHandler)
+{
+	counters = srv->getCounters();
+}
+
 MiniHttpServer::~MiniHttpServer() {
-	if (running) srv->stopCycle();
+	if (running) {
+		srv->stopCycle();
+		for (auto &&c: cores) if (c != srv) c->stopCycle();
+	}
 }
 
 MiniHttpServer &MiniHttpServer::operator >>(HTTPHandler &&handler) {
@@ -70,6 +125,12 @@ MiniHttpServer &MiniHttpServer::operator >>(HTTPHandler &&handler) {
 MiniHttpServer &MiniHttpServer::operator >>=(HTTPHandler &&handler) {
 
 	if (!running) {
+		for (auto &&c: cores) if (c != srv) {
+			c->ehndl = srv->ehndl;
+			c->preHandler = srv->preHandler;
+			c->setHndl(HTTPHandler(handler));
+			c->runCycle();
+		}
 		srv->setHndl(std::move(handler));
 		srv->runCycle();
 		running = true;
@@ -1,4 +1,5 @@
 #pragma once
+#include <vector>
 #include "abstractStreamFactory.h"
 #include "address.h"
 #include "asyncProvider.h"
@@ -82,7 +83,25 @@ namespace _intr {
 class MiniHttpServer {
 public:
 
+	///Configuration of thread per core mode
+	struct ThreadPerCore {
+		///count of cores. Set 0 to use all CPUs available for the process
+		unsigned int cores = 0;
+		///pin thread of every core to its CPU
+		bool pinThreads = true;
+	};
+
 	MiniHttpServer(NetAddr port, unsigned int threads, unsigned int dispatchers);
+	///Creates server in thread per core mode
+	/**
+	 * Every core has own thread, own dispatcher and own listening socket sharing the port
+	 * with other cores (SO_REUSEPORT). A connection is accepted and processed by single
+	 * core for its whole lifetime, the cores don't share any lock.
+	 *
+	 * @param port port to listen
+	 * @param mode configuration
+	 */
+	MiniHttpServer(NetAddr port, const ThreadPerCore &mode);
 	MiniHttpServer(StreamFactory sf,unsigned int threads, unsigned int dispatchers);
 	MiniHttpServer(NetAddr port, AsyncProvider asyncProvider);
 	MiniHttpServer(StreamFactory sf, AsyncProvider asyncProvider);
@@ -97,7 +116,13 @@ public:
 protected:
 
 
+	typedef std::vector<RefCntPtr<_intr::MiniServerImpl> > Cores;
+
+	MiniHttpServer(Cores &&cores);
+
 	RefCntPtr<_intr::MiniServerImpl> srv;
+	///all cores in thread per core mode, the first core is srv. Empty in other modes
+	Cores cores;
 	bool running = false;
 public:
 	///Put there a function called on connection error
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 #include "abstractStream.h"
 
 namespace simpleServer {
@@ -52,6 +54,31 @@ protected:
 			writeLimit-=b.length - r.length;
 			return r;
 		}
+		virtual std::size_t implWriteVector(const BinaryView *buffers, std::size_t count, bool nonblock) override {
+			if (writeLimit == 0) {
+				std::size_t total = 0;
+				for (std::size_t i = 0; i < count; i++) total += buffers[i].length;
+				return total;
+			}
+			std::size_t n = 0, total = 0;
+			while (n < count && buffers[n].length <= writeLimit - total) total += buffers[n++].length;
+			if (n == 0) {
+				//first buffer crosses the limit
+				BinaryView r = implWrite(buffers[0], nonblock);
+				if (isEof(r)) return eofWritten;
+				return buffers[0].length - r.length;
+			}
+			//pass buffered data of the source with the buffers
+			std::size_t r = source->writeVector(buffers, n, nonblock?writeNonBlock:writeCanBlock);
+			if (r != eofWritten) writeLimit -= r;
+			return r;
+		}
+		virtual std::size_t implSendFile(int fd, std::size_t offset, std::size_t size, bool nonblock) override {
+			if (writeLimit == 0) return size;
+			std::size_t r = source->sendFile(fd, offset, std::min(size, writeLimit), nonblock?writeNonBlock:writeCanBlock);
+			if (r != eofWritten) writeLimit -= r;
+			return r;
+		}
 		virtual bool implWrite(WrBuffer &curBuffer, bool nonblock) override {
 			if (writeLimit < curBuffer.wrpos)
 				curBuffer.wrpos = writeLimit;
@@ -118,6 +145,9 @@ protected:
 		virtual bool canRunAsync() const override {
 			return source->canRunAsync();
 		}
+		virtual bool canSendFile() const override {
+			return source->canSendFile();
+		}
 
 
 
@@ -0,0 +1,375 @@
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdint>
+
+#include "../exceptions.h"
+#include "epollEventDispatcher.h"
+
+namespace simpleServer {
+
+
+static EpollEventDispatcher::Task empty_task([](AsyncState){},asyncOK);
+
+static const int maxEventsPerWait = 256;
+
+
+EpollEventDispatcher::EpollEventDispatcher(bool edgeTriggered)
+	:edgeTriggered(edgeTriggered)
+	,exitFlag(false)
+	,pendingCount(0)
+{
+	epollHandle = epoll_create1(EPOLL_CLOEXEC);
+	if (epollHandle < 0) {
+		int err = errno;
+		throw SystemException(err,"Failed to call epoll_create1 (EpollEventDispatcher)");
+	}
+	intrHandle = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+	if (intrHandle < 0) {
+		int err = errno;
+		close(epollHandle);
+		throw SystemException(err,"Failed to call eventfd (EpollEventDispatcher)");
+	}
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.fd = intrHandle;
+	if (epoll_ctl(epollHandle, EPOLL_CTL_ADD, intrHandle, &ev) < 0) {
+		int err = errno;
+		close(intrHandle);
+		close(epollHandle);
+		throw SystemException(err,"Failed to call epoll_ctl (EpollEventDispatcher)");
+	}
+}
+
+EpollEventDispatcher::~EpollEventDispatcher() noexcept {
+	close(intrHandle);
+	close(epollHandle);
+}
+
+void EpollEventDispatcher::runAsync(const AsyncResource &resource, int timeout, CompletionFn &&complfn) {
+	if (exitFlag || complfn == nullptr) {
+		if (complfn != nullptr) complfn(asyncCancel);
+		return;
+	}
+
+	RegReq req;
+	req.ares = resource;
+	req.completionFn = std::move(complfn);
+	if (timeout < 0) req.timeout = TimePoint::max();
+	else req.timeout = TimePoint::clock::now() + std::chrono::milliseconds(timeout);
+
+	pushRequest(std::move(req));
+}
+
+void EpollEventDispatcher::runAsync(CustomFn &&completion) {
+	if (exitFlag || completion == nullptr) {
+		if (completion != nullptr) completion();
+		return;
+	}
+
+	RegReq req;
+	req.completionFn = [fn=std::move(completion)](AsyncState){fn();};
+	req.timeout = TimePoint::max();
+
+	pushRequest(std::move(req));
+}
+
+void EpollEventDispatcher::runAfter(int ms, CustomFn &&completion) {
+	if (exitFlag || completion == nullptr) {
+		if (completion != nullptr) completion();
+		return;
+	}
+
+	RegReq req;
+	req.completionFn = [fn=std::move(completion)](AsyncState){fn();};
+	req.timeout = TimePoint::clock::now() + std::chrono::milliseconds(ms<0?0:ms);
+
+	pushRequest(std::move(req));
+}
+
+void EpollEventDispatcher::cancel(const AsyncResource &resource) {
+	RegReq req;
+	req.ares = resource;
+	req.completionFn = nullptr;
+
+	pushRequest(std::move(req));
+}
+
+void EpollEventDispatcher::sendIntr() {
+	std::uint64_t b = 1;
+	int r = ::write(intrHandle, &b, sizeof(b));
+	if (r < 0 && errno != EAGAIN) {
+		throw SystemException(errno);
+	}
+}
+
+void EpollEventDispatcher::pushRequest(RegReq &&req) {
+	if (queue.push(std::move(req))) sendIntr();
+}
+
+void EpollEventDispatcher::runQueue() {
+	queue.popAll([&](RegReq &&r) {
+		if (r.ares.socket == 0 && r.ares.op == 0) {
+			if (r.timeout == TimePoint::max()) {
+				readyTasks.push_back(Task(std::move(r.completionFn), asyncOK));
+			} else {
+				TimerData t;
+				t.completionFn = std::move(r.completionFn);
+				timers.add(r.timeout, std::move(t));
+				++pendingCount;
+			}
+		} else if (r.completionFn == nullptr) {
+			findAndCancel(r.ares);
+		} else {
+			addResource(r);
+		}
+	});
+}
+
+///wraps completion function, so it is called with the error as current exception
+static IAsyncProvider::CompletionFn withError(IAsyncProvider::CompletionFn &&fn, int err) {
+	return [fn = std::move(fn),err](AsyncState st) {
+		try {
+			throw SystemException(err, "Failed to register descriptor (EpollEventDispatcher)");
+		} catch (...) {
+			fn(st);
+		}
+	};
+}
+
+void EpollEventDispatcher::addResource(RegReq &req) {
+	int fd = req.ares.socket;
+	if (fd < 0) {
+		readyTasks.push_back(Task(withError(std::move(req.completionFn), EBADF), asyncError));
+		return;
+	}
+	if (static_cast<std::size_t>(fd) >= fdmap.size()) {
+		fdmap.resize(fd+1);
+	}
+	FDState &st = fdmap[fd];
+	Slot s = getSlot(req.ares.op);
+	FDOp &op = st.ops[s];
+	if (op.completionFn == nullptr) {
+		op.completionFn = std::move(req.completionFn);
+		++pendingCount;
+	} else {
+		//more then one waiting on the same resource - all of them are completed together
+		CompletionFn curFn = std::move(op.completionFn);
+		CompletionFn otherFn = std::move(req.completionFn);
+		op.completionFn = [curFn,otherFn](AsyncState st) {
+			curFn(st);
+			otherFn(st);
+		};
+	}
+	if (req.timeout != TimePoint::max()
+			&& (op.timer == Timers::noTimer || req.timeout < op.timeout)) {
+		if (op.timer != Timers::noTimer) timers.remove(op.timer);
+		TimerData t;
+		t.key = fd*2+s;
+		op.timer = timers.add(req.timeout, std::move(t));
+		op.timeout = req.timeout;
+	}
+
+	if (edgeTriggered) {
+		if (st.ready[s]) {
+			st.ready[s] = false;
+			completeSlot(fd, s, asyncOK);
+			return;
+		}
+		//descriptor is already registered when other direction is pending
+		if (st.ops[1-s].completionFn != nullptr && st.registered) return;
+	}
+	arm(fd, st);
+}
+
+void EpollEventDispatcher::arm(int fd, FDState &st) {
+	epoll_event ev = {};
+	ev.data.fd = fd;
+	int r;
+	if (edgeTriggered) {
+		ev.events = EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET;
+		//descriptor could be closed and reopened while it was idle, so always try to add it
+		r = epoll_ctl(epollHandle, EPOLL_CTL_ADD, fd, &ev);
+		if (r < 0 && errno == EEXIST) r = 0;
+	} else {
+		ev.events = EPOLLONESHOT;
+		if (st.ops[slotRead].completionFn != nullptr) ev.events |= EPOLLIN|EPOLLRDHUP;
+		if (st.ops[slotWrite].completionFn != nullptr) ev.events |= EPOLLOUT;
+		if (st.registered) {
+			r = epoll_ctl(epollHandle, EPOLL_CTL_MOD, fd, &ev);
+			if (r < 0 && errno == ENOENT) r = epoll_ctl(epollHandle, EPOLL_CTL_ADD, fd, &ev);
+		} else {
+			r = epoll_ctl(epollHandle, EPOLL_CTL_ADD, fd, &ev);
+			if (r < 0 && errno == EEXIST) r = epoll_ctl(epollHandle, EPOLL_CTL_MOD, fd, &ev);
+		}
+	}
+	if (r < 0) {
+		st.registered = false;
+		failResource(fd, errno);
+	} else {
+		st.registered = true;
+	}
+}
+
+void EpollEventDispatcher::failResource(int fd, int err) {
+	if (fd < 0 || static_cast<std::size_t>(fd) >= fdmap.size()) return;
+	if (err == EPERM) {
+		//descriptor doesn't support epoll (regular file) - it is always ready
+		completeSlot(fd, slotRead, asyncOK);
+		completeSlot(fd, slotWrite, asyncOK);
+		return;
+	}
+	for (Slot s: {slotRead, slotWrite}) {
+		FDOp &op = fdmap[fd].ops[s];
+		if (op.completionFn != nullptr) {
+			op.completionFn = withError(std::move(op.completionFn), err);
+			completeSlot(fd, s, asyncError);
+		}
+	}
+}
+
+void EpollEventDispatcher::completeSlot(int fd, Slot slot, AsyncState state) {
+	FDOp &op = fdmap[fd].ops[slot];
+	if (op.completionFn == nullptr) return;
+	if (op.timer != Timers::noTimer) {
+		timers.remove(op.timer);
+		op.timer = Timers::noTimer;
+	}
+	readyTasks.push_back(Task(std::move(op.completionFn), state));
+	op.completionFn = nullptr;
+	--pendingCount;
+}
+
+void EpollEventDispatcher::findAndCancel(const AsyncResource &res) {
+	int fd = res.socket;
+	if (fd < 0 || static_cast<std::size_t>(fd) >= fdmap.size()) return;
+	if (res.op & POLLOUT) completeSlot(fd, slotWrite, asyncCancel);
+	if (res.op & (POLLIN|POLLPRI|POLLRDHUP)) completeSlot(fd, slotRead, asyncCancel);
+}
+
+void EpollEventDispatcher::onEvent(int fd, unsigned int events) {
+	if (fd < 0 || static_cast<std::size_t>(fd) >= fdmap.size()) return;
+	FDState &st = fdmap[fd];
+	bool err = (events & (EPOLLERR|EPOLLHUP)) != 0;
+	bool rd = err || (events & (EPOLLIN|EPOLLPRI|EPOLLRDHUP)) != 0;
+	bool wr = err || (events & EPOLLOUT) != 0;
+	bool sig[2] = {rd, wr};
+	for (Slot s: {slotRead, slotWrite}) if (sig[s]) {
+		if (st.ops[s].completionFn != nullptr) {
+			completeSlot(fd, s, asyncOK);
+		} else if (edgeTriggered) {
+			st.ready[s] = true;
+		}
+	}
+	//one-shot registration is disabled now, rearm for remaining direction
+	if (!edgeTriggered
+			&& (st.ops[slotRead].completionFn != nullptr || st.ops[slotWrite].completionFn != nullptr)) {
+		arm(fd, st);
+	}
+}
+
+void EpollEventDispatcher::checkTimeouts(const TimePoint &now) {
+	timers.advance(now, [&](TimerData &&t) {
+		if (t.key < 0) {
+			readyTasks.push_back(Task(std::move(t.completionFn), asyncOK));
+			--pendingCount;
+		} else {
+			int fd = t.key >> 1;
+			Slot s = static_cast<Slot>(t.key & 1);
+			fdmap[fd].ops[s].timer = Timers::noTimer;
+			completeSlot(fd, s, asyncTimeout);
+		}
+	});
+}
+
+EpollEventDispatcher::Task EpollEventDispatcher::nextReady() {
+	Task t = std::move(readyTasks.front());
+	readyTasks.pop_front();
+	return t;
+}
+
+EpollEventDispatcher::Task EpollEventDispatcher::cleanup() {
+	queue.popAll([&](RegReq &&r) {
+		if (r.completionFn != nullptr) {
+			readyTasks.push_back(Task(std::move(r.completionFn), asyncCancel));
+		}
+	});
+	if (pendingCount) {
+		int cnt = static_cast<int>(fdmap.size());
+		for (int i = 0; i < cnt; i++) {
+			completeSlot(i, slotRead, asyncCancel);
+			completeSlot(i, slotWrite, asyncCancel);
+		}
+		//timers created by runAfter() are executed now
+		timers.clear([&](TimerData &&t) {
+			readyTasks.push_back(Task(std::move(t.completionFn), asyncCancel));
+			--pendingCount;
+		});
+	}
+	if (!readyTasks.empty()) return nextReady();
+	return Task();
+}
+
+EpollEventDispatcher::Task EpollEventDispatcher::wait() {
+
+	if (exitFlag) {
+		return cleanup();
+	}
+
+	if (!readyTasks.empty()) return nextReady();
+
+	runQueue();
+	checkTimeouts(TimePoint::clock::now());
+
+	int timeout_ms = -1;
+	TimePoint nextTimeout = timers.nextExpiration();
+	if (!readyTasks.empty()) {
+		//don't sleep, but collect events, so I/O is not starved by a stream of requests
+		timeout_ms = 0;
+	} else if (nextTimeout != TimePoint::max()) {
+		auto dur = std::chrono::ceil<std::chrono::milliseconds>(nextTimeout - TimePoint::clock::now());
+		timeout_ms = dur.count() < 0?0:static_cast<int>(dur.count());
+	}
+
+	//when a request arrived meanwhile, just collect events and process the request
+	if (timeout_ms != 0 && !queue.prepareSleep()) timeout_ms = 0;
+
+	epoll_event events[maxEventsPerWait];
+	int r = epoll_wait(epollHandle, events, maxEventsPerWait, timeout_ms);
+	queue.wakeUp();
+	if (r < 0) {
+		int e = errno;
+		if (e != EINTR && e != EAGAIN)
+			throw SystemException(e, "Failed to call epoll_wait()");
+	} else {
+		for (int i = 0; i < r; i++) {
+			if (events[i].data.fd == intrHandle) {
+				std::uint64_t b;
+				(void)::read(intrHandle, &b, sizeof(b));
+			} else {
+				onEvent(events[i].data.fd, events[i].events);
+			}
+		}
+	}
+	runQueue();
+	checkTimeouts(TimePoint::clock::now());
+	if (!readyTasks.empty()) return nextReady();
+	return empty_task;
+}
+
+bool EpollEventDispatcher::empty() const {
+	return pendingCount == 0;
+}
+
+void EpollEventDispatcher::stop() {
+	exitFlag = true;
+	sendIntr();
+}
+
+unsigned int EpollEventDispatcher::getPendingCount() const {
+	return pendingCount;
+}
+
+
+} /* namespace simpleServer */
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <poll.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "../asyncProvider.h"
+#include "../mpscQueue.h"
+#include "../timerWheel.h"
+#include "async.h"
+
+
+
+namespace simpleServer {
+
+///Event dispatcher based on epoll
+/**
+ * Registrations are kept in the kernel and indexed by the descriptor, so registration,
+ * completion and cancelation cost O(1) per descriptor regardless of count of idle connections.
+ *
+ * In level-triggered mode, descriptors are armed as one-shot, so every registration costs one
+ * epoll_ctl(). In edge-triggered mode, descriptors stay registered for both directions and
+ * the dispatcher remembers readiness reported while nobody was waiting. A registration on already
+ * ready descriptor is completed without calling the kernel
+ *
+ * Timeouts and timers created by runAfter() are kept in a timing wheel, so they cost O(1) as well.
+ *
+ * @note Closing a descriptor which has a pending operation removes it from the epoll set
+ * silently. Such operation completes only by its timeout or by cancel().
+ */
+class EpollEventDispatcher: public AbstractStreamEventDispatcher {
+public:
+	EpollEventDispatcher(bool edgeTriggered = false);
+	virtual ~EpollEventDispatcher() noexcept;
+
+	virtual void runAsync(const AsyncResource &resource, int timeout, CompletionFn &&complfn) override;
+
+	virtual void runAsync(CustomFn &&completion) override;
+
+	virtual void runAfter(int ms, CustomFn &&completion) override;
+
+	virtual void cancel(const AsyncResource &resource) override;
+
+
+	virtual Task wait() override;
+
+
+	///returns true, if the listener doesn't contain any asynchronous task
+	virtual bool empty() const override;
+
+	virtual void stop() override;
+
+	virtual unsigned int getPendingCount() const override;
+
+protected:
+
+	typedef std::chrono::time_point<std::chrono::steady_clock> TimePoint;
+
+	///index of operation slot - every descriptor can wait for reading and writing at the same time
+	enum Slot {
+		slotRead = 0,
+		slotWrite = 1
+	};
+
+	struct TimerData {
+		///contains descriptor and slot packed to single number (fd*2+slot), -1 for runAfter()
+		int key = -1;
+		CompletionFn completionFn;
+	};
+
+	typedef TimerWheel<TimerData> Timers;
+
+	struct FDOp {
+		CompletionFn completionFn;
+		Timers::TimerID timer = Timers::noTimer;
+		TimePoint timeout;
+	};
+
+	struct FDState {
+		FDOp ops[2];
+		///true, if the descriptor has been added to the epoll
+		bool registered = false;
+		///readiness reported in edge-triggered mode while no operation has been pending
+		bool ready[2] = {false,false};
+	};
+
+	struct RegReq {
+		AsyncResource ares;
+		CompletionFn completionFn;
+		TimePoint timeout;
+	};
+
+	typedef std::vector<FDState> FDMap;
+
+	FDMap fdmap;
+	Timers timers;
+	std::deque<Task> readyTasks;
+
+	int epollHandle;
+	int intrHandle;
+	bool edgeTriggered;
+
+	std::atomic<bool> exitFlag;
+	std::atomic<unsigned int> pendingCount;
+
+	///requests from other threads, the dispatcher is woken up only when it is sleeping
+	MPSCQueue<RegReq> queue;
+
+
+	static Slot getSlot(int op) {return (op & POLLOUT)?slotWrite:slotRead;}
+
+	void sendIntr();
+	void pushRequest(RegReq &&req);
+	void runQueue();
+	void addResource(RegReq &req);
+	void findAndCancel(const AsyncResource &res);
+	void completeSlot(int fd, Slot slot, AsyncState st);
+	void arm(int fd, FDState &st);
+	void onEvent(int fd, unsigned int events);
+	void checkTimeouts(const TimePoint &now);
+	void failResource(int fd, int err);
+
+	Task cleanup();
+	Task nextReady();
+
+
+};
+
+} /* namespace simpleServer */
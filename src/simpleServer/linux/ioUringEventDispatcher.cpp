@@ -0,0 +1,604 @@
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "../exceptions.h"
+#include "ioUringEventDispatcher.h"
+
+namespace simpleServer {
+
+
+static IoUringEventDispatcher::Task empty_task([](AsyncState){},asyncOK);
+
+///user data of the poll on the interrupt handle
+static const std::uint64_t userIntr = ~static_cast<std::uint64_t>(0);
+///user data of operations which don't need a completion (cancelation)
+static const std::uint64_t userIgnore = ~static_cast<std::uint64_t>(0) - 1;
+
+static int sys_io_uring_setup(unsigned int entries, io_uring_params *p) {
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int sys_io_uring_enter(int fd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags, const void *arg, std::size_t argsz) {
+	return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argsz));
+}
+
+static std::uint64_t packUserData(unsigned int idx, std::uint32_t generation) {
+	return (static_cast<std::uint64_t>(generation) << 32) | idx;
+}
+
+static void *mapRing(int fd, std::size_t size, off_t offset) {
+	void *p = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, offset);
+	return p == MAP_FAILED?nullptr:p;
+}
+
+///wraps completion function, so it is called with the error as current exception
+static IAsyncProvider::CompletionFn withError(IAsyncProvider::CompletionFn &&fn, int err) {
+	return [fn = std::move(fn),err](AsyncState st) {
+		try {
+			throw SystemException(err, "Asynchronous operation failed (IoUringEventDispatcher)");
+		} catch (...) {
+			fn(st);
+		}
+	};
+}
+
+///binds the result to the completion function of the direct operation
+static IAsyncProvider::CompletionFn withResult(IAsyncProvider::IOCompletionFn &&fn, int res) {
+	return [fn = std::move(fn),res](AsyncState st) {
+		fn(st, res);
+	};
+}
+
+
+IoUringEventDispatcher::IoUringEventDispatcher(unsigned int entries)
+	:exitFlag(false)
+	,pendingCount(0)
+{
+	initRing(entries);
+	intrHandle = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+	if (intrHandle < 0) {
+		int err = errno;
+		closeRing();
+		throw SystemException(err,"Failed to call eventfd (IoUringEventDispatcher)");
+	}
+}
+
+IoUringEventDispatcher::~IoUringEventDispatcher() noexcept {
+	//the kernel can still access buffers of pending operations
+	if (activeOps) {
+		try {
+			cancelAll();
+		} catch (...) {
+		}
+	}
+	close(intrHandle);
+	closeRing();
+}
+
+void IoUringEventDispatcher::initRing(unsigned int entries) {
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	ringHandle = sys_io_uring_setup(entries, &params);
+	if (ringHandle < 0) {
+		int err = errno;
+		throw SystemException(err,"Failed to call io_uring_setup (IoUringEventDispatcher)");
+	}
+	features = params.features;
+	//waiting with timeout and keeping of overflowed completions are required
+	unsigned int required = IORING_FEAT_EXT_ARG|IORING_FEAT_NODROP;
+	if ((features & required) != required) {
+		close(ringHandle);
+		throw SystemException(ENOSYS,"The kernel doesn't support required features of io_uring (IoUringEventDispatcher)");
+	}
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (features & IORING_FEAT_SINGLE_MMAP) {
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+	}
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+	sqRingPtr = mapRing(ringHandle, sqRingSize, IORING_OFF_SQ_RING);
+	if (sqRingPtr) {
+		if (features & IORING_FEAT_SINGLE_MMAP) cqRingPtr = sqRingPtr;
+		else cqRingPtr = mapRing(ringHandle, cqRingSize, IORING_OFF_CQ_RING);
+	}
+	if (cqRingPtr) {
+		sqes = static_cast<io_uring_sqe *>(mapRing(ringHandle, sqesSize, IORING_OFF_SQES));
+	}
+	if (sqes == nullptr) {
+		int err = errno;
+		closeRing();
+		throw SystemException(err,"Failed to map io_uring (IoUringEventDispatcher)");
+	}
+
+	char *sq = static_cast<char *>(sqRingPtr);
+	sqHead = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+	sqTail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+	sqMask = *reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+	sqEntries = params.sq_entries;
+	//submission entries are always used in order
+	unsigned int *sqArray = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+	for (unsigned int i = 0; i < sqEntries; i++) sqArray[i] = i;
+	sqLocalTail = *sqTail;
+
+	char *cq = static_cast<char *>(cqRingPtr);
+	cqHead = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+	cqTail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+	cqMask = *reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+void IoUringEventDispatcher::closeRing() noexcept {
+	if (sqes) munmap(sqes, sqesSize);
+	if (cqRingPtr && cqRingPtr != sqRingPtr) munmap(cqRingPtr, cqRingSize);
+	if (sqRingPtr) munmap(sqRingPtr, sqRingSize);
+	sqes = nullptr;
+	cqRingPtr = sqRingPtr = nullptr;
+	close(ringHandle);
+}
+
+void IoUringEventDispatcher::runAsync(const AsyncResource &resource, int timeout, CompletionFn &&complfn) {
+	if (exitFlag || complfn == nullptr) {
+		if (complfn != nullptr) complfn(asyncCancel);
+		return;
+	}
+
+	RegReq req;
+	req.ares = resource;
+	req.completionFn = std::move(complfn);
+	if (timeout < 0) req.timeout = TimePoint::max();
+	else req.timeout = TimePoint::clock::now() + std::chrono::milliseconds(timeout);
+
+	pushRequest(std::move(req));
+}
+
+void IoUringEventDispatcher::runAsync(CustomFn &&completion) {
+	if (exitFlag || completion == nullptr) {
+		if (completion != nullptr) completion();
+		return;
+	}
+
+	RegReq req;
+	req.completionFn = [fn=std::move(completion)](AsyncState){fn();};
+	req.timeout = TimePoint::max();
+
+	pushRequest(std::move(req));
+}
+
+void IoUringEventDispatcher::runAfter(int ms, CustomFn &&completion) {
+	if (exitFlag || completion == nullptr) {
+		if (completion != nullptr) completion();
+		return;
+	}
+
+	RegReq req;
+	req.completionFn = [fn=std::move(completion)](AsyncState){fn();};
+	req.timeout = TimePoint::clock::now() + std::chrono::milliseconds(ms<0?0:ms);
+
+	pushRequest(std::move(req));
+}
+
+bool IoUringEventDispatcher::runAsyncIO(IOOperation op, const AsyncResource &resource, void *buffer, std::size_t size, int timeout, IOCompletionFn &&complfn) {
+	if (exitFlag) {
+		complfn(asyncCancel, 0);
+		return true;
+	}
+
+	RegReq req;
+	req.ares = resource;
+	req.ioCompletionFn = std::move(complfn);
+	req.ioop = op;
+	req.buffer = buffer;
+	req.size = size;
+	if (timeout < 0) req.timeout = TimePoint::max();
+	else req.timeout = TimePoint::clock::now() + std::chrono::milliseconds(timeout);
+
+	pushRequest(std::move(req));
+	return true;
+}
+
+void IoUringEventDispatcher::cancel(const AsyncResource &resource) {
+	RegReq req;
+	req.ares = resource;
+	req.completionFn = nullptr;
+
+	pushRequest(std::move(req));
+}
+
+void IoUringEventDispatcher::sendIntr() {
+	std::uint64_t b = 1;
+	int r = ::write(intrHandle, &b, sizeof(b));
+	if (r < 0 && errno != EAGAIN) {
+		throw SystemException(errno);
+	}
+}
+
+void IoUringEventDispatcher::pushRequest(RegReq &&req) {
+	if (queue.push(std::move(req))) sendIntr();
+}
+
+void IoUringEventDispatcher::runQueue() {
+	queue.popAll([&](RegReq &&r) {
+		if (r.ioCompletionFn != nullptr) {
+			addOperation(r);
+		} else if (r.ares.socket == 0 && r.ares.op == 0) {
+			if (r.timeout == TimePoint::max()) {
+				readyTasks.push_back(Task(std::move(r.completionFn), asyncOK));
+			} else {
+				TimerData t;
+				t.completionFn = std::move(r.completionFn);
+				timers.add(r.timeout, std::move(t));
+				++pendingCount;
+			}
+		} else if (r.completionFn == nullptr) {
+			findAndCancel(r.ares);
+		} else {
+			addOperation(r);
+		}
+	});
+}
+
+void IoUringEventDispatcher::addOperation(RegReq &req) {
+	int fd = req.ares.socket;
+	if (fd < 0) {
+		if (req.ioCompletionFn != nullptr) {
+			readyTasks.push_back(Task(withResult(std::move(req.ioCompletionFn), -EBADF), asyncOK));
+		} else {
+			readyTasks.push_back(Task(withError(std::move(req.completionFn), EBADF), asyncError));
+		}
+		return;
+	}
+
+	unsigned int idx;
+	if (freeOps.empty()) {
+		idx = static_cast<unsigned int>(ops.size());
+		ops.emplace_back();
+	} else {
+		idx = freeOps.back();
+		freeOps.pop_back();
+	}
+	OpState &op = ops[idx];
+	op.fd = fd;
+	op.cancelState = asyncOK;
+	op.waitReady = false;
+	if (req.ioCompletionFn != nullptr) {
+		op.ioCompletionFn = std::move(req.ioCompletionFn);
+		op.events = -1;
+		op.ioop = req.ioop;
+		op.buffer = req.buffer;
+		op.size = req.size;
+		op.addrLen = static_cast<socklen_t>(req.size);
+		op.slot = req.ioop == ioSend?slotWrite:slotRead;
+	} else {
+		op.completionFn = std::move(req.completionFn);
+		op.events = req.ares.op;
+		op.slot = getSlot(req.ares.op);
+	}
+
+	if (static_cast<std::size_t>(fd) >= fdmap.size()) {
+		fdmap.resize(fd+1);
+	}
+	unsigned int &head = fdmap[fd].ops[op.slot];
+	op.prev = noOp;
+	op.next = head;
+	if (head != noOp) ops[head].prev = idx;
+	head = idx;
+
+	if (req.timeout != TimePoint::max()) {
+		TimerData t;
+		t.op = idx;
+		op.timer = timers.add(req.timeout, std::move(t));
+	}
+	++activeOps;
+	++pendingCount;
+	submitOperation(idx);
+}
+
+io_uring_sqe *IoUringEventDispatcher::getSqe() {
+	while (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+		//submission queue is full, pass it to the kernel now
+		if (enter(0, 0, false) < 0) processCompletions();
+	}
+	io_uring_sqe *sqe = sqes + (sqLocalTail & sqMask);
+	std::memset(sqe, 0, sizeof(*sqe));
+	++sqLocalTail;
+	++toSubmit;
+	return sqe;
+}
+
+void IoUringEventDispatcher::submitOperation(unsigned int idx) {
+	io_uring_sqe *sqe = getSqe();
+	OpState &op = ops[idx];
+	sqe->fd = op.fd;
+	sqe->user_data = packUserData(idx, op.generation);
+	if (op.events >= 0) {
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = static_cast<unsigned int>(op.events);
+	} else if (op.waitReady) {
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = op.slot == slotWrite?POLLOUT:POLLIN|POLLRDHUP;
+	} else {
+		unsigned int len = static_cast<unsigned int>(std::min<std::size_t>(op.size, 0x7FFFFFFF));
+		switch (op.ioop) {
+		case ioRecv:
+			sqe->opcode = IORING_OP_RECV;
+			sqe->addr = reinterpret_cast<std::uint64_t>(op.buffer);
+			sqe->len = len;
+			sqe->msg_flags = MSG_NOSIGNAL;
+			break;
+		case ioSend:
+			sqe->opcode = IORING_OP_SEND;
+			sqe->addr = reinterpret_cast<std::uint64_t>(op.buffer);
+			sqe->len = len;
+			sqe->msg_flags = MSG_NOSIGNAL;
+			break;
+		case ioAccept:
+			sqe->opcode = IORING_OP_ACCEPT;
+			sqe->addr = reinterpret_cast<std::uint64_t>(op.buffer);
+			sqe->addr2 = reinterpret_cast<std::uint64_t>(&op.addrLen);
+			sqe->accept_flags = SOCK_NONBLOCK|SOCK_CLOEXEC;
+			break;
+		}
+	}
+}
+
+void IoUringEventDispatcher::armIntr() {
+	io_uring_sqe *sqe = getSqe();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = intrHandle;
+	sqe->poll32_events = POLLIN;
+	sqe->user_data = userIntr;
+	intrArmed = true;
+}
+
+void IoUringEventDispatcher::cancelOperation(unsigned int idx, AsyncState state) {
+	OpState &op = ops[idx];
+	if (op.cancelState != asyncOK) return;
+	op.cancelState = state;
+	std::uint64_t target = packUserData(idx, op.generation);
+	io_uring_sqe *sqe = getSqe();
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = target;
+	sqe->user_data = userIgnore;
+	if (features & IORING_FEAT_CQE_SKIP) sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+}
+
+void IoUringEventDispatcher::findAndCancel(const AsyncResource &res) {
+	int fd = res.socket;
+	if (fd < 0 || static_cast<std::size_t>(fd) >= fdmap.size()) return;
+	//the list can change while cancelation is submitted
+	std::vector<std::uint64_t> found;
+	for (Slot s: {slotRead, slotWrite}) {
+		bool match = s == slotWrite?(res.op & POLLOUT) != 0:(res.op & (POLLIN|POLLPRI|POLLRDHUP)) != 0;
+		if (!match) continue;
+		for (unsigned int idx = fdmap[fd].ops[s]; idx != noOp; idx = ops[idx].next) {
+			found.push_back(packUserData(idx, ops[idx].generation));
+		}
+	}
+	for (std::uint64_t ud: found) {
+		unsigned int idx = static_cast<unsigned int>(ud);
+		if (ops[idx].fd >= 0 && packUserData(idx, ops[idx].generation) == ud) {
+			cancelOperation(idx, asyncCancel);
+		}
+	}
+}
+
+void IoUringEventDispatcher::checkTimeouts(const TimePoint &now) {
+	std::vector<std::uint64_t> expired;
+	timers.advance(now, [&](TimerData &&t) {
+		if (t.op == noOp) {
+			readyTasks.push_back(Task(std::move(t.completionFn), asyncOK));
+			--pendingCount;
+		} else {
+			OpState &op = ops[t.op];
+			op.timer = Timers::noTimer;
+			expired.push_back(packUserData(t.op, op.generation));
+		}
+	});
+	for (std::uint64_t ud: expired) {
+		unsigned int idx = static_cast<unsigned int>(ud);
+		if (ops[idx].fd >= 0 && packUserData(idx, ops[idx].generation) == ud) {
+			cancelOperation(idx, asyncTimeout);
+		}
+	}
+}
+
+int IoUringEventDispatcher::enter(unsigned int minComplete, int timeout_ms, bool getEvents) {
+	__atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+
+	__kernel_timespec ts;
+	io_uring_getevents_arg arg;
+	std::memset(&arg, 0, sizeof(arg));
+	if (minComplete && timeout_ms >= 0) {
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		arg.ts = reinterpret_cast<std::uint64_t>(&ts);
+	}
+	unsigned int flags = IORING_ENTER_EXT_ARG;
+	if (getEvents) flags |= IORING_ENTER_GETEVENTS;
+
+	int r = sys_io_uring_enter(ringHandle, toSubmit, minComplete, flags, &arg, sizeof(arg));
+	if (r < 0) {
+		int e = errno;
+		if (e != EINTR && e != EAGAIN && e != EBUSY && e != ETIME)
+			throw SystemException(e, "Failed to call io_uring_enter()");
+		return -1;
+	}
+	toSubmit -= std::min(static_cast<unsigned int>(r), toSubmit);
+	return r;
+}
+
+void IoUringEventDispatcher::processCompletions() {
+	unsigned int head = *cqHead;
+	unsigned int tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		const io_uring_cqe &cqe = cqes[head & cqMask];
+		std::uint64_t userData = cqe.user_data;
+		int res = cqe.res;
+		++head;
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+		onCompletion(userData, res);
+	}
+}
+
+void IoUringEventDispatcher::onCompletion(std::uint64_t userData, int res) {
+	if (userData == userIgnore) return;
+	if (userData == userIntr) {
+		std::uint64_t b;
+		(void)::read(intrHandle, &b, sizeof(b));
+		intrArmed = false;
+		return;
+	}
+	unsigned int idx = static_cast<unsigned int>(userData);
+	if (idx >= ops.size()) return;
+	OpState &op = ops[idx];
+	if (op.fd < 0 || packUserData(idx, op.generation) != userData) return;
+
+	if (op.cancelState != asyncOK && res == -ECANCELED) {
+		finishOperation(idx, op.cancelState, 0);
+	} else if (op.events >= 0) {
+		finishOperation(idx, res < 0?asyncError:asyncOK, res);
+	} else if (op.waitReady) {
+		//the descriptor is ready, the caller performs the operation
+		finishOperation(idx, asyncOK, res < 0?res:ioReady);
+	} else if (res == -EAGAIN) {
+		//older kernels don't wait on non-blocking sockets, wait for readiness instead
+		if (op.cancelState != asyncOK) {
+			finishOperation(idx, op.cancelState, 0);
+		} else {
+			op.waitReady = true;
+			submitOperation(idx);
+		}
+	} else {
+		finishOperation(idx, asyncOK, res);
+	}
+}
+
+void IoUringEventDispatcher::finishOperation(unsigned int idx, AsyncState state, int res) {
+	OpState &op = ops[idx];
+	if (op.timer != Timers::noTimer) {
+		timers.remove(op.timer);
+		op.timer = Timers::noTimer;
+	}
+	if (op.events < 0) {
+		readyTasks.push_back(Task(withResult(std::move(op.ioCompletionFn), res), state));
+	} else if (state == asyncError) {
+		readyTasks.push_back(Task(withError(std::move(op.completionFn), -res), state));
+	} else {
+		readyTasks.push_back(Task(std::move(op.completionFn), state));
+	}
+	releaseOperation(idx);
+}
+
+void IoUringEventDispatcher::releaseOperation(unsigned int idx) {
+	OpState &op = ops[idx];
+	if (op.prev != noOp) ops[op.prev].next = op.next;
+	else fdmap[op.fd].ops[op.slot] = op.next;
+	if (op.next != noOp) ops[op.next].prev = op.prev;
+	op.prev = op.next = noOp;
+	op.completionFn = nullptr;
+	op.ioCompletionFn = nullptr;
+	op.fd = -1;
+	op.buffer = nullptr;
+	//all ones are reserved for own user data
+	if (++op.generation == 0xFFFFFFFF) op.generation = 0;
+	freeOps.push_back(idx);
+	--activeOps;
+	--pendingCount;
+}
+
+void IoUringEventDispatcher::cancelAll() {
+	unsigned int cnt = static_cast<unsigned int>(ops.size());
+	for (unsigned int i = 0; i < cnt; i++) {
+		if (ops[i].fd >= 0) cancelOperation(i, asyncCancel);
+	}
+	//operations are completed after the kernel confirms the cancelation
+	while (activeOps) {
+		enter(1, -1, true);
+		processCompletions();
+	}
+}
+
+IoUringEventDispatcher::Task IoUringEventDispatcher::nextReady() {
+	Task t = std::move(readyTasks.front());
+	readyTasks.pop_front();
+	return t;
+}
+
+IoUringEventDispatcher::Task IoUringEventDispatcher::cleanup() {
+	queue.popAll([&](RegReq &&r) {
+		if (r.ioCompletionFn != nullptr) {
+			readyTasks.push_back(Task(withResult(std::move(r.ioCompletionFn), 0), asyncCancel));
+		} else if (r.completionFn != nullptr) {
+			readyTasks.push_back(Task(std::move(r.completionFn), asyncCancel));
+		}
+	});
+	if (pendingCount) {
+		if (activeOps) cancelAll();
+		//timers created by runAfter() are executed now
+		timers.clear([&](TimerData &&t) {
+			readyTasks.push_back(Task(std::move(t.completionFn), asyncCancel));
+			--pendingCount;
+		});
+	}
+	if (!readyTasks.empty()) return nextReady();
+	return Task();
+}
+
+IoUringEventDispatcher::Task IoUringEventDispatcher::wait() {
+
+	if (exitFlag) {
+		return cleanup();
+	}
+
+	if (!readyTasks.empty()) return nextReady();
+
+	runQueue();
+	checkTimeouts(TimePoint::clock::now());
+	if (!intrArmed) armIntr();
+
+	int timeout_ms = -1;
+	TimePoint nextTimeout = timers.nextExpiration();
+	if (!readyTasks.empty()) {
+		//don't sleep, but collect completions, so I/O is not starved by a stream of requests
+		timeout_ms = 0;
+	} else if (nextTimeout != TimePoint::max()) {
+		auto dur = std::chrono::ceil<std::chrono::milliseconds>(nextTimeout - TimePoint::clock::now());
+		timeout_ms = dur.count() < 0?0:static_cast<int>(dur.count());
+	}
+
+	//when a request arrived meanwhile, just collect completions and process the request
+	if (timeout_ms != 0 && !queue.prepareSleep()) timeout_ms = 0;
+
+	//submits collected operations and waits for completions by single system call
+	enter(timeout_ms == 0?0:1, timeout_ms, true);
+	queue.wakeUp();
+	processCompletions();
+
+	runQueue();
+	checkTimeouts(TimePoint::clock::now());
+	if (!readyTasks.empty()) return nextReady();
+	return empty_task;
+}
+
+bool IoUringEventDispatcher::empty() const {
+	return pendingCount == 0;
+}
+
+void IoUringEventDispatcher::stop() {
+	exitFlag = true;
+	sendIntr();
+}
+
+unsigned int IoUringEventDispatcher::getPendingCount() const {
+	return pendingCount;
+}
+
+
+} /* namespace simpleServer */
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "../asyncProvider.h"
+#include "../mpscQueue.h"
+#include "../timerWheel.h"
+#include "async.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace simpleServer {
+
+///Event dispatcher based on io_uring
+/**
+ * Every operation is submitted to the ring. Waiting for readiness of a resource is
+ * submitted as poll operation, so all existing streams work without a change. Operations
+ * started by runAsyncIO() are performed by the kernel directly, so there is no extra system
+ * call to read or write the data.
+ *
+ * Submissions are collected and passed to the kernel by the same system call, which also
+ * waits for completions. All completions available at that time are processed together.
+ *
+ * Timeouts and timers are kept in a timing wheel. An operation which timeouts is canceled
+ * in the kernel and it is completed once the kernel confirms the cancelation, so the buffer
+ * is not accessed after the completion function is called
+ *
+ * The constructor throws SystemException when the kernel doesn't support io_uring or
+ * some of required features
+ *
+ * @note The kernel cancels operations submitted by a thread which exits. The threads which
+ * call wait() should live as long as the dispatcher
+ */
+class IoUringEventDispatcher: public AbstractStreamEventDispatcher {
+public:
+	IoUringEventDispatcher(unsigned int entries = 256);
+	virtual ~IoUringEventDispatcher() noexcept;
+
+	virtual void runAsync(const AsyncResource &resource, int timeout, CompletionFn &&complfn) override;
+
+	virtual void runAsync(CustomFn &&completion) override;
+
+	virtual void runAfter(int ms, CustomFn &&completion) override;
+
+	virtual bool runAsyncIO(IOOperation op, const AsyncResource &resource, void *buffer, std::size_t size, int timeout, IOCompletionFn &&complfn) override;
+
+	virtual void cancel(const AsyncResource &resource) override;
+
+
+	virtual Task wait() override;
+
+
+	///returns true, if the listener doesn't contain any asynchronous task
+	virtual bool empty() const override;
+
+	virtual void stop() override;
+
+	virtual unsigned int getPendingCount() const override;
+
+protected:
+
+	typedef std::chrono::time_point<std::chrono::steady_clock> TimePoint;
+
+	///index of operation slot - every descriptor can wait for reading and writing at the same time
+	enum Slot {
+		slotRead = 0,
+		slotWrite = 1
+	};
+
+	static const unsigned int noOp = ~0U;
+
+	struct TimerData {
+		///index of operation, noOp for runAfter()
+		unsigned int op = noOp;
+		CompletionFn completionFn;
+	};
+
+	typedef TimerWheel<TimerData> Timers;
+
+	///Operation submitted to the ring
+	struct OpState {
+		///completion function of waiting for readiness
+		CompletionFn completionFn;
+		///completion function of the direct operation
+		IOCompletionFn ioCompletionFn;
+		int fd = -1;
+		Slot slot = slotRead;
+		///poll events, or -1 for the direct operation
+		int events = -1;
+		IOOperation ioop = ioRecv;
+		void *buffer = nullptr;
+		std::size_t size = 0;
+		///length of the address for ioAccept, the kernel writes here
+		socklen_t addrLen = 0;
+		///changed with every reuse of the slot, so stale cancelation doesn't hit a new operation
+		std::uint32_t generation = 0;
+		///state reported when the kernel confirms cancelation, asyncOK if not canceled
+		AsyncState cancelState = asyncOK;
+		///direct operation reported EAGAIN and it now waits for readiness
+		bool waitReady = false;
+		Timers::TimerID timer = Timers::noTimer;
+		///operations waiting on the same descriptor and slot
+		unsigned int prev = noOp, next = noOp;
+	};
+
+	struct FDState {
+		unsigned int ops[2] = {noOp, noOp};
+	};
+
+	struct RegReq {
+		AsyncResource ares;
+		CompletionFn completionFn;
+		IOCompletionFn ioCompletionFn;
+		IOOperation ioop = ioRecv;
+		void *buffer = nullptr;
+		std::size_t size = 0;
+		TimePoint timeout;
+	};
+
+	int ringHandle;
+	int intrHandle;
+	unsigned int features;
+
+	void *sqRingPtr = nullptr;
+	void *cqRingPtr = nullptr;
+	std::size_t sqRingSize = 0;
+	std::size_t cqRingSize = 0;
+	io_uring_sqe *sqes = nullptr;
+	std::size_t sqesSize = 0;
+
+	unsigned int *sqHead;
+	unsigned int *sqTail;
+	unsigned int sqMask;
+	unsigned int sqEntries;
+	unsigned int *cqHead;
+	unsigned int *cqTail;
+	unsigned int cqMask;
+	io_uring_cqe *cqes;
+
+	///local tail of submission queue, published before the kernel is entered
+	unsigned int sqLocalTail = 0;
+	///count of submissions not yet passed to the kernel
+	unsigned int toSubmit = 0;
+
+	///operations - deque, because the kernel receives pointer to OpState::addrLen
+	std::deque<OpState> ops;
+	std::vector<unsigned int> freeOps;
+	///count of operations in the ring
+	unsigned int activeOps = 0;
+	std::vector<FDState> fdmap;
+	Timers timers;
+	std::deque<Task> readyTasks;
+	///the ring waits for interrupt
+	bool intrArmed = false;
+
+	std::atomic<bool> exitFlag;
+	std::atomic<unsigned int> pendingCount;
+
+	///requests from other threads, the dispatcher is woken up only when it is sleeping
+	MPSCQueue<RegReq> queue;
+
+
+	static Slot getSlot(int op) {return (op & POLLOUT)?slotWrite:slotRead;}
+
+	void initRing(unsigned int entries);
+	void closeRing() noexcept;
+
+	void sendIntr();
+	void pushRequest(RegReq &&req);
+	void runQueue();
+	void addOperation(RegReq &req);
+	void findAndCancel(const AsyncResource &res);
+	void cancelOperation(unsigned int idx, AsyncState state);
+	void checkTimeouts(const TimePoint &now);
+
+	io_uring_sqe *getSqe();
+	void submitOperation(unsigned int idx);
+	void armIntr();
+	int enter(unsigned int minComplete, int timeout_ms, bool getEvents);
+	void processCompletions();
+	void onCompletion(std::uint64_t userData, int res);
+	void finishOperation(unsigned int idx, AsyncState state, int res);
+	void releaseOperation(unsigned int idx);
+	void cancelAll();
+
+	Task cleanup();
+	Task nextReady();
+
+
+};
+
+} /* namespace simpleServer */
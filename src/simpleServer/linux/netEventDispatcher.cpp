@@ -7,6 +7,9 @@
 
 
 #include <fcntl.h>
+#include <atomic>
+#include <cstdint>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 
 #include <unistd.h>
@@ -14,6 +17,8 @@
 #include "../exceptions.h"
 #include "../mt.h"
 #include "netEventDispatcher.h"
+#include "epollEventDispatcher.h"
+#include "ioUringEventDispatcher.h"
 
 namespace simpleServer {
 
@@ -22,13 +27,11 @@ static LinuxEventDispatcher::Task empty_task([](AsyncState){},asyncOK);
 
 
 LinuxEventDispatcher::LinuxEventDispatcher() {
-	int fds[2];
-	if (pipe2(fds, O_CLOEXEC)!=0) {
+	intrHandle = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+	if (intrHandle < 0) {
 		int err = errno;
-		throw SystemException(err,"Failed to call pipe2 (LinuxEventDispatcher)");
+		throw SystemException(err,"Failed to call eventfd (LinuxEventDispatcher)");
 	}
-	intrHandle = fds[1];
-	intrWaitHandle = fds[0];
 
 
 	addIntrWaitHandle();
@@ -38,35 +41,32 @@ LinuxEventDispatcher::LinuxEventDispatcher() {
 
 LinuxEventDispatcher::~LinuxEventDispatcher() noexcept {
 	close(intrHandle);
-	close(intrWaitHandle);
 }
 
 template<typename T>
 void ignore_variable(T) {}
 
-LinuxEventDispatcher::Task LinuxEventDispatcher::runQueue() {
-	std::lock_guard<std::mutex> _(queueLock);
-	char b;
-	ignore_variable(::read(intrWaitHandle, &b, 1));
-
-
-
-	if (!queue.empty()) {
-		const RegReq &r = queue.front();
+void LinuxEventDispatcher::runQueue() {
+	queue.popAll([&](RegReq &&r) {
 		if (r.ares.socket == 0 && r.ares.op == 0) {
-			Task t(r.extra.completionFn,asyncOK);
-			queue.pop();
-			return t;
+			if (r.extra.timeout != TimePoint::max()) {
+				timers.add(r.extra.timeout, std::move(r.extra.completionFn));
+			} else {
+				readyTasks.push(Task(r.extra.completionFn,asyncOK));
+			}
 		} else if (r.extra.completionFn == nullptr) {
-			auto q = r.ares;
-			queue.pop();
-			return findAndCancel(q);
+			Task t = findAndCancel(r.ares);
+			if (t != nullptr) readyTasks.push(t);
 		} else {
 			addResource(r);
-			queue.pop();
 		}
-	}
-	return Task();
+	});
+}
+
+LinuxEventDispatcher::Task LinuxEventDispatcher::nextReady() {
+	Task t = readyTasks.front();
+	readyTasks.pop();
+	return t;
 }
 
 LinuxEventDispatcher::Task LinuxEventDispatcher::findAndCancel(const AsyncResource &res) {
@@ -93,7 +93,7 @@ LinuxEventDispatcher::Task LinuxEventDispatcher::findAndCancel(const AsyncResour
 void LinuxEventDispatcher::addIntrWaitHandle() {
 
 	RegReq rq;
-	rq.ares = AsyncResource(intrWaitHandle, POLLIN);
+	rq.ares = AsyncResource(intrHandle, POLLIN);
 	rq.extra.completionFn = empty_task;
 	rq.extra.timeout = TimePoint::max();
 	addResource(rq);
@@ -112,9 +112,7 @@ void LinuxEventDispatcher::runAsync(const AsyncResource &resource, int timeout,
 	if (timeout < 0) req.extra.timeout = TimePoint::max();
 	else req.extra.timeout = TimePoint::clock::now() + std::chrono::milliseconds(timeout);
 
-	std::lock_guard<std::mutex> _(queueLock);
-	queue.push(req);
-	sendIntr();
+	pushRequest(std::move(req));
 
 }
 
@@ -127,10 +125,22 @@ void LinuxEventDispatcher::runAsync(CustomFn &&completion)  {
 
 	RegReq req;
 	req.extra.completionFn = [fn=std::move(completion)](AsyncState){fn();};
+	req.extra.timeout = TimePoint::max();
 
-	std::lock_guard<std::mutex> _(queueLock);
-	queue.push(req);
-	sendIntr();
+	pushRequest(std::move(req));
+}
+
+void LinuxEventDispatcher::runAfter(int ms, CustomFn &&completion)  {
+	if (exitFlag || completion == nullptr) {
+		if (completion != nullptr) completion();
+		return;
+	}
+
+	RegReq req;
+	req.extra.completionFn = [fn=std::move(completion)](AsyncState){fn();};
+	req.extra.timeout = TimePoint::clock::now() + std::chrono::milliseconds(ms<0?0:ms);
+
+	pushRequest(std::move(req));
 }
 
 void LinuxEventDispatcher::addResource(const RegReq &req) {
@@ -165,10 +175,10 @@ LinuxEventDispatcher::Task LinuxEventDispatcher::checkEvents(const TimePoint &no
 	while (last_checked < sz) {
 		int idx = last_checked++;
 		if (fdmap[idx].revents) {
-			if (fdmap[idx].fd == intrWaitHandle) {
-				Task t = runQueue();
+			if (fdmap[idx].fd == intrHandle) {
+				std::uint64_t b;
+				ignore_variable(::read(intrHandle, &b, sizeof(b)));
 				fdmap[idx].revents = 0;
-				if (t != nullptr) return t;
 			} else {
 				Task t(fdextramap[idx].completionFn, asyncOK);
 				deleteResource(idx);
@@ -198,7 +208,7 @@ void LinuxEventDispatcher::stop() {
 }
 
 unsigned int LinuxEventDispatcher::getPendingCount() const {
-	return fdmap.size();
+	return fdmap.size()+timers.size();
 }
 
 void LinuxEventDispatcher::cancel(const AsyncResource& resource) {
@@ -206,14 +216,20 @@ void LinuxEventDispatcher::cancel(const AsyncResource& resource) {
 	req.ares = resource;
 	req.extra.completionFn = nullptr;
 
-	std::lock_guard<std::mutex> _(queueLock);
-	queue.push(req);
-	sendIntr();
+	pushRequest(std::move(req));
 
 }
 
 LinuxEventDispatcher::Task LinuxEventDispatcher::cleanup() {
-	if (!fdmap.empty()) {
+	queue.popAll([&](RegReq &&r) {
+		if (r.extra.completionFn != nullptr) readyTasks.push(Task(r.extra.completionFn, asyncCancel));
+	});
+	timers.clear([&](CompletionFn &&fn){
+		readyTasks.push(Task(fn, asyncCancel));
+	});
+	if (!readyTasks.empty()) {
+		return nextReady();
+	} else if (!fdmap.empty()) {
 		int idx = fdmap.size()-1;
 		Task t(fdextramap[idx].completionFn, asyncCancel);
 		deleteResource(idx);
@@ -231,12 +247,30 @@ LinuxEventDispatcher::Task LinuxEventDispatcher::wait() {
 		return cleanup();
 	}
 
+	if (!readyTasks.empty()) return nextReady();
+
+	runQueue();
 	TimePoint now = std::chrono::steady_clock::now();
+	timers.advance(now, [&](CompletionFn &&fn){
+		readyTasks.push(Task(fn, asyncOK));
+	});
+
 	Task x = checkEvents(now,true);
 	if (x != nullptr) return x;
 
-	auto int_ms = std::chrono::duration_cast<std::chrono::milliseconds>(nextTimeout - now);
-	int r = poll(fdmap.data(),fdmap.size(),int_ms.count());
+	TimePoint waitUntil = std::min(nextTimeout, timers.nextExpiration());
+	int int_ms = -1;
+	if (!readyTasks.empty()) {
+		//don't sleep, but collect events, so I/O is not starved by a stream of requests
+		int_ms = 0;
+	} else if (waitUntil != TimePoint::max()) {
+		auto dur = std::chrono::ceil<std::chrono::milliseconds>(waitUntil - now);
+		int_ms = dur.count() < 0?0:static_cast<int>(dur.count());
+	}
+	//when a request arrived meanwhile, just collect events and process the request
+	if (int_ms != 0 && !queue.prepareSleep()) int_ms = 0;
+	int r = poll(fdmap.data(),fdmap.size(),int_ms);
+	queue.wakeUp();
 
 
 	if (r < 0) {
@@ -248,20 +282,49 @@ LinuxEventDispatcher::Task LinuxEventDispatcher::wait() {
 		x = checkEvents(now,false);
 		if (x != nullptr) return x;
 	}
+	runQueue();
+	if (!readyTasks.empty()) return nextReady();
 	return empty_task;
 }
 
 
 void LinuxEventDispatcher::sendIntr() {
-	unsigned char b = 1;
-	int r = ::write(intrHandle, &b, 1);
-	if (r < 0) {
+	std::uint64_t b = 1;
+	int r = ::write(intrHandle, &b, sizeof(b));
+	if (r < 0 && errno != EAGAIN) {
 		throw SystemException(errno);
 	}
 }
 
+void LinuxEventDispatcher::pushRequest(RegReq &&req) {
+	if (queue.push(std::move(req))) sendIntr();
+}
+
+static std::atomic<AbstractStreamEventDispatcher::Backend> defaultBackend(AbstractStreamEventDispatcher::backendEpoll);
+
 PStreamEventDispatcher AbstractStreamEventDispatcher::create() {
-	return new LinuxEventDispatcher;
+	return create(defaultBackend);
+}
+
+PStreamEventDispatcher AbstractStreamEventDispatcher::create(Backend backend) {
+	switch (backend) {
+	case backendPoll: return new LinuxEventDispatcher;
+	case backendEpollEdge: return new EpollEventDispatcher(true);
+	case backendEpoll: return new EpollEventDispatcher(false);
+	case backendIoUring:
+		try {
+			return new IoUringEventDispatcher;
+		} catch (SystemException &) {
+			//io_uring is not available (old kernel, or disabled by the system)
+			return new EpollEventDispatcher(false);
+		}
+	default: return create();
+	}
+}
+
+void AbstractStreamEventDispatcher::setDefaultBackend(Backend backend) {
+	if (backend == backendDefault) backend = backendEpoll;
+	defaultBackend = backend;
 }
 
 
@@ -2,7 +2,6 @@
 
 #include <poll.h>
 #include <chrono>
-#include <mutex>
 #include <queue>
 #include <unordered_map>
 #include <utility>
@@ -11,6 +10,8 @@
 
 #include "../asyncProvider.h"
 #include "../stringview.h"
+#include "../mpscQueue.h"
+#include "../timerWheel.h"
 #include "async.h"
 
 
@@ -26,6 +27,8 @@ public:
 
 	virtual void runAsync(CustomFn &&completion) override;
 
+	virtual void runAfter(int ms, CustomFn &&completion) override;
+
 	virtual void cancel(const AsyncResource &resource) override;
 
 
@@ -59,6 +62,10 @@ protected:
 	typedef std::vector<FDExtra> FDExtraMap;
 	FDMap fdmap;
 	FDExtraMap fdextramap;
+	///timers created by runAfter()
+	TimerWheel<CompletionFn> timers;
+	///tasks ready to be returned by wait()
+	std::queue<Task> readyTasks;
 
 
 	void addResource(const RegReq &req);
@@ -68,19 +75,20 @@ protected:
 	Task findAndCancel(const AsyncResource &res);
 
 	int intrHandle;
-	int intrWaitHandle;
 
 	bool exitFlag;
 	TimePoint nextTimeout =  TimePoint::max();
 	int last_checked = 0;
 
 
-	mutable std::mutex queueLock;
-	std::queue<RegReq> queue;
+	///requests from other threads, the dispatcher is woken up only when it is sleeping
+	MPSCQueue<RegReq> queue;
 	void sendIntr();
+	void pushRequest(RegReq &&req);
 
 	Task cleanup();
-	Task runQueue();
+	void runQueue();
+	Task nextReady();
 
 };
 
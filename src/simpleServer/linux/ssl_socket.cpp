@@ -58,6 +58,14 @@ public:
 
 	virtual BinaryView implRead(MutableBinaryView buffer, bool nonblock) override;
 	virtual BinaryView implWrite(BinaryView buffer, bool nonblock) override;
+	virtual std::size_t implWriteVector(const BinaryView *buffers, std::size_t count, bool nonblock) override {
+		//data must pass through SSL, the socket cannot be written directly
+		return IGeneralStream::implWriteVector(buffers, count, nonblock);
+	}
+	virtual bool canSendFile() const override {
+		//file is encrypted in the user space
+		return false;
+	}
 	virtual void implCloseOutput() override;
 	virtual void implReadAsync(const MutableBinaryView& buffer, Callback&& cb) override;
 	virtual void implWriteAsync(const BinaryView& data, Callback&& cb) override;
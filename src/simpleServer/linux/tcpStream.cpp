@@ -6,6 +6,9 @@
 #include "async.h"
 
 #include <poll.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <algorithm>
 
 
 #ifndef POLLRDHUP
@@ -45,6 +48,59 @@ BinaryView TCPStream::implWrite(BinaryView buffer, bool nonblock) {
 	} while (true);
 }
 
+std::size_t TCPStream::implWriteVector(const BinaryView *buffers, std::size_t count, bool nonblock) {
+	static const std::size_t maxIov = 64;
+	struct iovec iov[maxIov];
+	std::size_t n = std::min(count, maxIov);
+	for (std::size_t i = 0; i < n; i++) {
+		iov[i].iov_base = const_cast<unsigned char *>(buffers[i].data);
+		iov[i].iov_len = buffers[i].length;
+	}
+	struct msghdr msg = {};
+	msg.msg_iov = iov;
+	msg.msg_iovlen = n;
+	do {
+		ssize_t r = sendmsg(sck, &msg, MSG_DONTWAIT|MSG_NOSIGNAL);
+		if (r < 0) {
+			int e = errno;
+			if (e == EPIPE) {
+				return eofWritten;
+			}
+			if (e != EWOULDBLOCK && e != EINTR && e != EAGAIN)
+				throw SystemException(e,__FUNCTION__);
+			if (nonblock) return 0;
+			if (!implWaitForWrite(iotimeout)) {
+				throw TimeoutException();
+			}
+		} else {
+			return static_cast<std::size_t>(r);
+		}
+	} while (true);
+}
+std::size_t TCPStream::implSendFile(int fd, std::size_t offset, std::size_t size, bool nonblock) {
+	off_t off = offset;
+	do {
+		ssize_t r = ::sendfile(sck, fd, &off, size);
+		if (r < 0) {
+			int e = errno;
+			if (e == EPIPE) {
+				return eofWritten;
+			}
+			if (e != EWOULDBLOCK && e != EINTR && e != EAGAIN)
+				throw SystemException(e,__FUNCTION__);
+			if (nonblock) return 0;
+			if (!implWaitForWrite(iotimeout)) {
+				throw TimeoutException();
+			}
+		} else {
+			return static_cast<std::size_t>(r);
+		}
+	} while (true);
+}
+
+bool TCPStream::canSendFile() const {
+	return true;
+}
 
 bool TCPStream::doPoll(int sock, int events, int timeoutms) {
 	struct pollfd pfd;
@@ -92,7 +148,7 @@ static void disableNagle(int socket) {
 
 
 TCPStream::TCPStream(int sck, int iotimeout, const NetAddr& peer)
-	:sck(sck),iotimeout(iotimeout),peer(peer)
+	:sck(sck),iotimeout(iotimeout),peer(peer),noAsyncIO(false)
 {
 	disableNagle(sck);
 
@@ -171,6 +227,34 @@ void TCPStream::asyncWriteCallback(const BinaryView& b, Callback&& cbc, AsyncSta
 
 }
 
+void TCPStream::asyncRecvCallback(const MutableBinaryView& b, Callback&& cbc, AsyncState state, int res) {
+	if (state != asyncOK) {
+		cbc(state, BinaryView(0,0));
+	} else if (res == IAsyncProvider::ioReady) {
+		asyncReadCallback(b, std::move(cbc), state);
+	} else if (res == 0 || res == -ECONNRESET) {
+		cbc(asyncEOF, eofConst);
+	} else if (res < 0) {
+		throw SystemException(-res,__FUNCTION__);
+	} else {
+		cbc(state, BinaryView(b.data, res));
+	}
+}
+
+void TCPStream::asyncSendCallback(const BinaryView& b, Callback&& cbc, AsyncState state, int res) {
+	if (state != asyncOK) {
+		cbc(state, BinaryView(0,0));
+	} else if (res == IAsyncProvider::ioReady) {
+		asyncWriteCallback(b, std::move(cbc), state);
+	} else if (res == 0 || res == -EPIPE) {
+		cbc(asyncEOF, eofConst);
+	} else if (res < 0) {
+		throw SystemException(-res,__FUNCTION__);
+	} else {
+		cbc(state, b.substr(res));
+	}
+}
+
 
 void TCPStream::implReadAsync(const MutableBinaryView& buffer, Callback&& cb) {
 	if (asyncProvider == nullptr) throw NoAsyncProviderException();
@@ -178,6 +262,24 @@ void TCPStream::implReadAsync(const MutableBinaryView& buffer, Callback&& cb) {
 
 	MutableBinaryView b(buffer);
 
+	if (!noAsyncIO) {
+		IAsyncProvider::IOCompletionFn iofn = [me,cbc=std::move(cb),b](AsyncState state, int res) mutable {
+			try {
+				me->asyncRecvCallback(b, std::move(cbc), state, res);
+			} catch (...) {
+				cbc(asyncError, BinaryView(0,0));
+			}
+		};
+		if (asyncProvider->runAsyncIO(IAsyncProvider::ioRecv, AsyncResource(sck, POLLIN), b.data, b.length, iotimeout, std::move(iofn)))
+			return;
+		//provider can only wait for readiness, don't try it next time
+		noAsyncIO = true;
+		asyncProvider->runAsync(AsyncResource(sck, POLLIN), iotimeout, [iofn = std::move(iofn)](AsyncState state) {
+			iofn(state, IAsyncProvider::ioReady);
+		});
+		return;
+	}
+
 	auto fn = [me,cbc=std::move(cb),b](AsyncState state) mutable {
 		try {
 			me->asyncReadCallback(b, std::move(cbc), state);
@@ -195,6 +297,25 @@ void TCPStream::implWriteAsync(const BinaryView& data, Callback&& cb) {
 
 	BinaryView b(data);
 
+	if (!noAsyncIO) {
+		IAsyncProvider::IOCompletionFn iofn = [me,cbc=std::move(cb),b](AsyncState state, int res) mutable {
+			try {
+				me->asyncSendCallback(b, std::move(cbc), state, res);
+			} catch (...) {
+				cbc(asyncError, BinaryView(0,0));
+			}
+		};
+		//the buffer is not modified by send
+		void *ptr = const_cast<unsigned char *>(b.data);
+		if (asyncProvider->runAsyncIO(IAsyncProvider::ioSend, AsyncResource(sck, POLLOUT), ptr, b.length, iotimeout, std::move(iofn)))
+			return;
+		noAsyncIO = true;
+		asyncProvider->runAsync(AsyncResource(sck, POLLOUT), iotimeout, [iofn = std::move(iofn)](AsyncState state) {
+			iofn(state, IAsyncProvider::ioReady);
+		});
+		return;
+	}
+
 	auto fn = [me,cbc=std::move(cb), b](AsyncState state) mutable  {
 		try {
 			me->asyncWriteCallback(b,std::move(cbc),state);
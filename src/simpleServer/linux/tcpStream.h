@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include "../abstractStream.h"
 #include "../address.h"
 
@@ -16,6 +18,7 @@ public:
 	virtual int setIOTimeout(int timeoutms) override;
 	int getSocket() const {return sck;}
 	int getIOTimeout() const {return iotimeout;}
+	virtual bool canSendFile() const override;
 
 protected:
 
@@ -24,6 +27,8 @@ protected:
 	virtual BinaryView implRead(MutableBinaryView buffer, bool nonblock) override;
 	virtual BinaryView implWrite(BinaryView buffer, bool nonblock) override;
 	virtual bool implWrite(WrBuffer &curBuffer, bool nonblock) override;
+	virtual std::size_t implWriteVector(const BinaryView *buffers, std::size_t count, bool nonblock) override;
+	virtual std::size_t implSendFile(int fd, std::size_t offset, std::size_t size, bool nonblock) override;
 	virtual void implReadAsync(Callback &&cb) override;
 	virtual void implReadAsync(const MutableBinaryView &buffer, Callback &&cb)  override;
 	virtual void implWriteAsync(const BinaryView &data, Callback &&cb)  override;
@@ -48,9 +53,13 @@ protected:
 	int sck;
 	int iotimeout;
 	NetAddr peer;
+	///set when the provider cannot perform I/O directly, so the stream waits for readiness
+	std::atomic<bool> noAsyncIO;
 
 	virtual void asyncReadCallback(const MutableBinaryView& buffer, Callback&& cb, AsyncState state);
 	virtual void asyncWriteCallback(const BinaryView& data, Callback&& cb, AsyncState state);
+	void asyncRecvCallback(const MutableBinaryView& buffer, Callback&& cb, AsyncState state, int res);
+	void asyncSendCallback(const BinaryView& data, Callback&& cb, AsyncState state, int res);
 
 	static bool doPoll(int sock, int events, int timeoutms);
 
@@ -1,5 +1,7 @@
 #include <fcntl.h>
 #include <cstring>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include "tcpStreamFactory.h"
 
@@ -8,6 +10,7 @@
 #include <poll.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -20,6 +23,7 @@
 #include "tcpStream.h"
 #include "localAddr.h"
 #include <csignal>
+#include <thread>
 
 using ondra_shared::Handle;
 
@@ -201,7 +205,41 @@ static SocketObject listenSocket(const NetAddr &addr) {
 }
 
 
-TCPListen::TCPListen(NetAddr source, int listenTimeout, int ioTimeout):TCPStreamFactory(source, ioTimeout),listenTimeout(listenTimeout) {
+///Creates listening socket which shares the port with other sockets (SO_REUSEPORT)
+static SocketObject listenSocketShared(const NetAddr &addr, int incomingCpu) {
+	BinaryView sa = addr.toSockAddr();
+	const struct sockaddr *saddr = reinterpret_cast<const struct sockaddr *>(sa.data);
+	if (saddr->sa_family != AF_INET && saddr->sa_family != AF_INET6) {
+		throw SystemException(EAFNOSUPPORT,"Sharded listening is supported on TCP addresses only:" + addr.toString(false));
+	}
+	SocketObject s(socket(saddr->sa_family, SOCK_STREAM|SOCK_CLOEXEC, 0));
+	if (!s) throw SystemException(errno,"Failed to create socket");
+	int enable = 1;
+	(void)setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int));
+	if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(int)) == -1) {
+		int e = errno;
+		throw SystemException(e,"Failed to set SO_REUSEPORT:" + addr.toString(false));
+	}
+	if (incomingCpu >= 0) {
+		//just a hint, ignore failure on older kernels
+		(void)setsockopt(s, SOL_SOCKET, SO_INCOMING_CPU, &incomingCpu, sizeof(int));
+	}
+	if (saddr->sa_family == AF_INET6)
+		(void)setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, &enable, sizeof(int));
+	(void)ioctl(s, FIONBIO, &enable);
+	if (::bind(s, saddr, sa.length) == -1) {
+		int e = errno;
+		throw SystemException(e,"Cannot bind socket to port:" + addr.toString(false));
+	}
+	if (::listen(s,SOMAXCONN) == -1) {
+		int e = errno;
+		throw SystemException(e,"Cannot activate listen mode on the socket:" + addr.toString(false));
+	}
+	return s;
+}
+
+
+TCPListen::TCPListen(NetAddr source, int listenTimeout, int ioTimeout):TCPStreamFactory(source, ioTimeout),listenTimeout(listenTimeout),acceptBatch(defaultAcceptBatch) {
 	NetAddr t = source;
 	bool hasNext = true;
 	do {
@@ -210,7 +248,39 @@ TCPListen::TCPListen(NetAddr source, int listenTimeout, int ioTimeout):TCPStream
 		hasNext = a != nullptr;
 		t = a;
 	} while (hasNext);
+	initTarget();
+}
+
+TCPListen::TCPListen(NetAddr source, int listenTimeout, int ioTimeout, int incomingCpu)
+	:TCPStreamFactory(source, ioTimeout),listenTimeout(listenTimeout),acceptBatch(defaultAcceptBatch) {
+	NetAddr t = source;
+	bool hasNext = true;
+	do {
+		openSockets.push_back(listenSocketShared(t, incomingCpu));
+		auto a = t.getNextAddr();
+		hasNext = a != nullptr;
+		t = a;
+	} while (hasNext);
+	initTarget();
+}
+
+std::vector<StreamFactory> TCPListen::createSharded(NetAddr source, unsigned int shards,
+		int listenTimeout, int ioTimeout, bool incomingCpu) {
+	if (shards == 0) shards = std::thread::hardware_concurrency();
+	if (shards == 0) shards = 1;
+	std::vector<StreamFactory> out;
+	out.reserve(shards);
+	TCPListen *first = new TCPListen(source, listenTimeout, ioTimeout, incomingCpu?0:-1);
+	out.push_back(first);
+	//the first shard could choose random port, so others must use its actual address
+	NetAddr bound = first->getLocalAddress();
+	for (unsigned int i = 1; i < shards; i++) {
+		out.push_back(new TCPListen(bound, listenTimeout, ioTimeout, incomingCpu?static_cast<int>(i):-1));
+	}
+	return out;
+}
 
+void TCPListen::initTarget() {
 	unsigned char buff[256];
 	socklen_t size = sizeof(buff);
 	getsockname(openSockets[0],reinterpret_cast<struct sockaddr *>(buff),&size);
@@ -261,6 +331,11 @@ static void fillPollFdListen(int s, pollfd &fd) {
 
 */
 
+static Stream acceptedConnect(int a, const struct sockaddr *sa, socklen_t slen, int iotimeout) {
+	NetAddr addr = NetAddr::create(BinaryView(reinterpret_cast<const unsigned char *>(sa), slen));
+	return new TCPStream(a,iotimeout, addr);
+}
+
 static Stream acceptConnect(int s, int iotimeout) {
 	unsigned char buff[256];
 	struct sockaddr *sa = reinterpret_cast<struct sockaddr *>(buff);
@@ -268,8 +343,7 @@ static Stream acceptConnect(int s, int iotimeout) {
 	//non blocking because multiple threads can try to claim the socket
 	int a = accept4(s, sa, &slen, SOCK_NONBLOCK|SOCK_CLOEXEC);
 	if (a > 0) {
-		NetAddr addr = NetAddr::create(BinaryView(reinterpret_cast<const unsigned char *>(&sa), slen));
-		return new TCPStream(a,iotimeout, addr);
+		return acceptedConnect(a, sa, slen, iotimeout);
 	} else {
 		int e =errno;
 		if (e != EINTR && e != EAGAIN && e != EWOULDBLOCK)
@@ -443,6 +517,15 @@ void TCPConnect::createAsync(const AsyncProvider &provider, const Callback &cb)
 }
 
 
+///length of the address returned by the kernel
+static socklen_t addrLength(const sockaddr_storage &addr) {
+	switch (addr.ss_family) {
+	case AF_INET: return sizeof(sockaddr_in);
+	case AF_INET6: return sizeof(sockaddr_in6);
+	default: return sizeof(sockaddr_storage);
+	}
+}
+
 class TCPListen::AsyncData: public RefCntObj {
 public:
 	AsyncData(TCPListen &owner):owner(owner),idleSockets(owner.openSockets.begin(), owner.openSockets.end()) {
@@ -450,9 +533,22 @@ public:
 
 
 	void onSignal(int socket, AsyncState state) {
+		onAccept(socket, state, IAsyncProvider::ioReady, nullptr);
+	}
+
+	///Finishes accepting of the connection
+	/**
+	 * @param socket listening socket
+	 * @param state state of the asynchronous operation
+	 * @param fd connection accepted by the provider, or ioReady when the socket is
+	 * ready and the connection must be accepted now. Negative value is an error
+	 * @param addr address of the peer, when the connection has been accepted by the provider
+	 */
+	void onAccept(int socket, AsyncState state, int fd, const sockaddr_storage *addr) {
 		Callback cb;
 		AsyncProvider p;
 		int iot, lst;
+		unsigned int batch;
 		bool stpd;
 		{
 			std::lock_guard<std::mutex> _(lock);
@@ -460,17 +556,28 @@ public:
 			std::swap(p,curProvider);
 			iot = iotimeout;
 			lst = listenTimeout;
+			batch = acceptBatch;
 			stpd = stopped;
 			idleSockets.push_back(socket);
 		}
-		if (cb!=nullptr) {
+		if (cb == nullptr) {
+			if (state == asyncOK && fd >= 0) ::close(fd);
+		} else {
 			if (state == asyncOK) {
 				try {
-					Stream sx = acceptConnect(socket, iot);
+					Stream sx;
+					if (fd == IAsyncProvider::ioReady) {
+						sx = acceptConnect(socket, iot);
+					} else if (fd < 0) {
+						throw SystemException(-fd, "Failed to accept socket");
+					} else {
+						sx = acceptedConnect(fd, reinterpret_cast<const sockaddr *>(addr), addrLength(*addr), iot);
+					}
 					if (sx == nullptr) {
-						charge(p,cb,lst,iot);
+						charge(p,cb,lst,iot,batch);
 					} else {
 						sx.setAsyncProvider(p);
+						acceptMore(socket, iot, batch, p);
 						cb(state,sx);
 					}
 				} catch (SystemException &e) {
@@ -488,15 +595,60 @@ public:
 	}
 
 
-	void charge(const AsyncProvider &p, const Callback &cb, int listenTimeout, int iotimeout) {
+	///Accepts remaining connections of the burst, they are delivered by following calls of charge()
+	void acceptMore(int socket, int iot, unsigned int batch, const AsyncProvider &p) {
+		std::vector<Stream> accepted;
+		for (unsigned int i = 1; batch == 0 || i < batch; i++) {
+			Stream sx;
+			try {
+				sx = acceptConnect(socket, iot);
+			} catch (...) {
+				//error will be reported by next readiness of the socket
+				break;
+			}
+			if (sx == nullptr) break;
+			sx.setAsyncProvider(p);
+			accepted.push_back(sx);
+		}
+		if (!accepted.empty()) {
+			std::lock_guard<std::mutex> _(lock);
+			backlog.insert(backlog.end(), accepted.begin(), accepted.end());
+		}
+	}
+
+	void charge(const AsyncProvider &p, const Callback &cb, int listenTimeout, int iotimeout, unsigned int acceptBatch) {
 		std::lock_guard<std::mutex> _(lock);
 
 		RefCntPtr<AsyncData> me(this);
+		this->acceptBatch = acceptBatch;
+		if (stopped) {
+			backlog.clear();
+		} else if (!backlog.empty()) {
+			//connection accepted during previous burst, no need to ask the dispatcher
+			Stream sx = backlog.front();
+			backlog.pop_front();
+			Callback ccb(cb);
+			p.runAsync([ccb,sx]{
+				ccb(asyncOK, sx);
+			});
+			return;
+		}
 		curCallback = cb;
 		curProvider = p;
 
 		for (int s: idleSockets) {
 
+			if (!noAsyncIO) {
+				//the provider accepts the connection, the address must live until completion
+				std::shared_ptr<sockaddr_storage> addr = std::make_shared<sockaddr_storage>();
+				IAsyncProvider::IOCompletionFn iofn = [me, s, addr](AsyncState state, int fd) {
+					me->onAccept(s, state, fd, addr.get());
+				};
+				if (p->runAsyncIO(IAsyncProvider::ioAccept, AsyncResource(s, POLLIN), addr.get(), sizeof(sockaddr_storage), listenTimeout, std::move(iofn)))
+					continue;
+				noAsyncIO = true;
+			}
+
 			auto fn = [me, s](AsyncState state){
 				me->onSignal(s, state);
 			};
@@ -509,7 +661,9 @@ public:
 	}
 
 	void setStopped() {
+		std::lock_guard<std::mutex> _(lock);
 		stopped = true;
+		backlog.clear();
 	}
 
 protected:
@@ -519,7 +673,12 @@ protected:
 	AsyncProvider curProvider;
 	int iotimeout;
 	int listenTimeout;
+	unsigned int acceptBatch = 1;
 	bool stopped = false;
+	///provider cannot accept connections directly
+	bool noAsyncIO = false;
+	///connections accepted during a burst, which were not delivered yet
+	std::deque<Stream> backlog;
 	std::mutex lock;
 
 };
@@ -533,8 +692,16 @@ void TCPListen::createAsync(const AsyncProvider &provider, const Callback &cb) {
 		asyncData = new AsyncData(*this);
 	}
 
-	asyncData->charge(provider, cb, listenTimeout,ioTimeout);
+	asyncData->charge(provider, cb, listenTimeout,ioTimeout,acceptBatch);
+
+}
+
+void TCPListen::setAcceptBatch(unsigned int count) {
+	acceptBatch = count;
+}
 
+void TCPListen::setAcceptBatch(const StreamFactory &sf, unsigned int count) {
+	dynamic_cast<TCPListen &>(*sf).setAcceptBatch(count);
 }
 
 void TCPListen::stop() {
@@ -1,4 +1,5 @@
 #include <memory>
+#include <vector>
 #include "../abstractStreamFactory.h"
 #include "../address.h"
 
@@ -84,11 +85,57 @@ public:
 	static StreamFactory create(bool localhost = true, unsigned int port=0,
 			 int listenTimeout = -1, int ioTimeout=-1);
 
+	///Creates sharded listener
+	/**
+	 * Opens the address by multiple listening sockets with SO_REUSEPORT, the kernel
+	 * distributes incoming connections between them. Every returned factory should be
+	 * driven by its own asynchronous provider with single dispatcher (for example
+	 * ThreadPoolAsync::create(1,1,-1)), so the connections stay on the thread which accepted
+	 * them and shards don't share any lock
+	 *
+	 * @param source address to listen. If the port is zero, the first shard selects
+	 * the port and other shards use the same port
+	 * @param shards count of shards. Set 0 to create one shard per CPU
+	 * @param listenTimeout timeout for listening
+	 * @param ioTimeout timeout for I/O operations on accepted streams
+	 * @param incomingCpu set true to assign the CPU index of the shard to the
+	 * sockets (SO_INCOMING_CPU). The kernel then prefers the shard running on the CPU which
+	 * processed the incoming packet. This is effective only when the thread of the shard
+	 * runs on the CPU with the same index
+	 * @return list of factories, one for each shard
+	 */
+	static std::vector<StreamFactory> createSharded(NetAddr source, unsigned int shards = 0,
+			int listenTimeout = -1, int ioTimeout=-1, bool incomingCpu = false);
+
+	///Sets maximum count of connections accepted on single readiness of the listening socket
+	/**
+	 * During a burst of connections, the listener calls accept() in a loop until the backlog
+	 * of the socket is empty or until the limit is reached. The callback of createAsync()
+	 * receives first connection, remaining connections are delivered on following calls of
+	 * createAsync() without waiting on the socket again.
+	 *
+	 * @param count maximum count of connections accepted in one batch. Value 1 disables
+	 * batching. Value 0 means no limit, which is required for edge-triggered dispatcher
+	 */
+	void setAcceptBatch(unsigned int count);
+	///Sets maximum count of connections accepted in one batch
+	/**
+	 * @param sf reference to stream factory
+	 * @param count maximum count of connections, see setAcceptBatch()
+	 * @exception std::bad_cast argument is not TCPListen
+	 */
+	static void setAcceptBatch(const StreamFactory &sf, unsigned int count);
+
+	///Default limit for setAcceptBatch
+	static const unsigned int defaultAcceptBatch = 32;
+
 	~TCPListen() noexcept;
 
 protected:
 
 	TCPListen(NetAddr source, int listenTimeout, int ioTimeout);
+	///Constructs a shard. Set incomingCpu to -1 to not assign the CPU
+	TCPListen(NetAddr source, int listenTimeout, int ioTimeout, int incomingCpu);
 	TCPListen(bool localhost, unsigned int port, int listenTimeout, int ioTimeout);
 	virtual Stream create() override;
 	virtual void stop() override;
@@ -100,7 +147,9 @@ protected:
 protected:
 
 	int listenTimeout;
+	std::atomic<unsigned int> acceptBatch;
 	std::vector<SocketObject> openSockets;
+	void initTarget();
 	std::atomic<bool> cbrace;
 
 	class AsyncData;
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace simpleServer {
+
+
+///Lock-free multiple producers single consumer queue
+/**
+ * Producers push items into a lock-free list. The consumer takes whole content at once and
+ * processes it in order of pushing, so the cost of synchronization is paid once per batch
+ * instead of once per item.
+ *
+ * The queue also tracks, whether the consumer is sleeping. The producer is informed by the
+ * function push() that it must wake the consumer, which happens only once per sleep
+ *
+ * @tparam T type of item
+ */
+template<typename T>
+class MPSCQueue {
+public:
+
+	MPSCQueue():head(nullptr),sleeping(false) {}
+	~MPSCQueue() {
+		popAll([](T &&){});
+	}
+
+	MPSCQueue(const MPSCQueue &) = delete;
+	MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+	///Pushes item to the queue
+	/**
+	 * @param item item to push
+	 * @retval true consumer is sleeping, producer must wake it up
+	 * @retval false consumer is running or somebody other already woke it up
+	 */
+	bool push(T &&item) {
+		Node *nd = new Node(std::move(item));
+		Node *h = head.load(std::memory_order_relaxed);
+		do {
+			nd->next = h;
+		} while (!head.compare_exchange_weak(h, nd, std::memory_order_seq_cst, std::memory_order_relaxed));
+		return sleeping.load(std::memory_order_seq_cst) && sleeping.exchange(false);
+	}
+
+	///Takes all items and processes them in order of pushing
+	/**
+	 * Only the consumer can call this function
+	 * @param fn function which receives every item as rvalue
+	 * @retval true processed at least one item
+	 * @retval false queue was empty
+	 */
+	template<typename Fn>
+	bool popAll(Fn &&fn) {
+		Node *h = head.exchange(nullptr, std::memory_order_acquire);
+		if (h == nullptr) return false;
+		//reverse list, it is stored from the newest item
+		Node *r = nullptr;
+		while (h) {
+			Node *n = h->next;
+			h->next = r;
+			r = h;
+			h = n;
+		}
+		while (r) {
+			Node *n = r->next;
+			T item(std::move(r->item));
+			delete r;
+			r = n;
+			fn(std::move(item));
+		}
+		return true;
+	}
+
+	///Returns true when queue is empty
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == nullptr;
+	}
+
+	///Consumer announces, that it is going to sleep
+	/**
+	 * @retval true consumer can sleep
+	 * @retval false queue is not empty, consumer should not sleep
+	 */
+	bool prepareSleep() {
+		sleeping.store(true, std::memory_order_seq_cst);
+		if (head.load(std::memory_order_seq_cst) != nullptr) {
+			sleeping.store(false, std::memory_order_relaxed);
+			return false;
+		}
+		return true;
+	}
+
+	///Consumer announces, that it has been woken up
+	void wakeUp() {
+		sleeping.store(false, std::memory_order_relaxed);
+	}
+
+protected:
+
+	struct Node {
+		T item;
+		Node *next = nullptr;
+		Node(T &&item):item(std::move(item)) {}
+	};
+
+	std::atomic<Node *> head;
+	std::atomic<bool> sleeping;
+
+};
+
+
+}
@@ -0,0 +1,72 @@
+#include "singleThreadAsync.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace simpleServer {
+
+SingleThreadAsyncImpl::SingleThreadAsyncImpl(int cpu)
+	:dispatcher(AbstractStreamEventDispatcher::create())
+	,stopped(false)
+{
+	thr = std::thread(&SingleThreadAsyncImpl::worker, dispatcher, cpu);
+}
+
+SingleThreadAsyncImpl::~SingleThreadAsyncImpl() {
+	SingleThreadAsyncImpl::stop();
+}
+
+void SingleThreadAsyncImpl::runAsync(const AsyncResource &resource, int timeout, CompletionFn &&complfn) {
+	dispatcher->runAsync(resource, timeout, std::move(complfn));
+}
+
+void SingleThreadAsyncImpl::runAsync(CustomFn &&completion) {
+	dispatcher->runAsync(std::move(completion));
+}
+
+void SingleThreadAsyncImpl::runAfter(int ms, CustomFn &&completion) {
+	dispatcher->runAfter(ms, std::move(completion));
+}
+
+bool SingleThreadAsyncImpl::runAsyncIO(IOOperation op, const AsyncResource &resource, void *buffer, std::size_t size, int timeout, IOCompletionFn &&complfn) {
+	return dispatcher->runAsyncIO(op, resource, buffer, size, timeout, std::move(complfn));
+}
+
+void SingleThreadAsyncImpl::cancel(const AsyncResource &resource) {
+	dispatcher->cancel(resource);
+}
+
+void SingleThreadAsyncImpl::stop() {
+	if (stopped.exchange(true)) return;
+	dispatcher->stop();
+	if (thr.joinable()) {
+		//the provider can be stopped (or destroyed) by own completion function
+		if (isCurrentThread()) thr.detach();
+		else thr.join();
+	}
+}
+
+bool SingleThreadAsyncImpl::isCurrentThread() const {
+	return thr.get_id() == std::this_thread::get_id();
+}
+
+void SingleThreadAsyncImpl::worker(PStreamEventDispatcher dispatcher, int cpu) noexcept {
+	if (cpu >= 0 && cpu < CPU_SETSIZE) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		//pinning is optimization, ignore failure
+		(void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+	for(;;) {
+		auto t = dispatcher->wait();
+		if (t == nullptr) break;
+		t();
+	}
+}
+
+AsyncProvider SingleThreadAsync::create(int cpu) {
+	return new SingleThreadAsyncImpl(cpu);
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "asyncProvider.h"
+
+namespace simpleServer {
+
+
+///Asynchronous provider which runs single dispatcher in single dedicated thread
+/**
+ * All completion functions are executed by the same thread, so the objects used only through
+ * this provider don't need any locking. The thread can be pinned to a CPU.
+ *
+ * The thread doesn't hold reference to the provider, the provider is stopped when the last
+ * reference is released
+ */
+class SingleThreadAsyncImpl: public AbstractAsyncProvider {
+public:
+
+	///Creates the provider and starts the thread
+	/**
+	 * @param cpu index of CPU to which the thread is pinned. Set -1 to not pin the thread
+	 */
+	SingleThreadAsyncImpl(int cpu = -1);
+	~SingleThreadAsyncImpl();
+
+	virtual void runAsync(const AsyncResource &resource, int timeout, CompletionFn &&complfn) override;
+
+	virtual void runAsync(CustomFn &&completion) override;
+
+	virtual void runAfter(int ms, CustomFn &&completion) override;
+
+	virtual bool runAsyncIO(IOOperation op, const AsyncResource &resource, void *buffer, std::size_t size, int timeout, IOCompletionFn &&complfn) override;
+
+	virtual void cancel(const AsyncResource &resource) override;
+
+	virtual void stop() override;
+
+	///Returns true, if the current thread is the thread of the provider
+	bool isCurrentThread() const;
+
+protected:
+
+	PStreamEventDispatcher dispatcher;
+	std::thread thr;
+	std::atomic<bool> stopped;
+
+	static void worker(PStreamEventDispatcher dispatcher, int cpu) noexcept;
+};
+
+
+class SingleThreadAsync {
+public:
+	///Creates asynchronous provider with single dedicated thread
+	/**
+	 * @param cpu index of CPU to which the thread is pinned. Set -1 to not pin the thread
+	 * @return asynchronous provider
+	 */
+	static AsyncProvider create(int cpu = -1);
+};
+
+
+}
@@ -1,6 +1,10 @@
 #include "threadPoolAsync.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <thread>
+#include <vector>
 
 #include "../simpleServer/mt.h"
 
@@ -8,6 +12,170 @@
 
 namespace simpleServer {
 
+
+///Work stealing executor
+/**
+ * Every thread has own queue. The tokens which allows to wait on a dispatcher are also tasks,
+ * so an idle thread can take the dispatcher while other thread processes a completion.
+ */
+class ThreadPoolAsyncImpl::WorkStealing {
+public:
+	typedef std::function<void()> Msg;
+
+	WorkStealing(unsigned int threads, const std::vector<PStreamEventDispatcher> &dispatchers);
+
+	///Pushes task to the queue of current thread
+	/** When called outside of the pool, the task is passed through a dispatcher, which wakes
+	 * the thread waiting for events
+	 */
+	void push(Msg &&msg);
+	///Selects dispatcher for new asynchronous operation
+	const PStreamEventDispatcher &selectDispatcher();
+	///Body of worker thread
+	void run(unsigned int index) noexcept;
+
+protected:
+
+	struct WorkQueue {
+		std::mutex lock;
+		std::deque<Msg> q;
+	};
+
+	std::vector<PStreamEventDispatcher> dispatchers;
+	///queue for every thread
+	std::vector<std::unique_ptr<WorkQueue> > queues;
+	std::atomic<unsigned int> activeDispatchers;
+	std::atomic<unsigned int> rrCounter;
+	std::atomic<unsigned int> epoch;
+	std::atomic<unsigned int> sleepers;
+	std::mutex sleepLock;
+	std::condition_variable sleepCond;
+
+	void pushTo(unsigned int index, Msg &&msg);
+	bool popLocal(unsigned int index, Msg &msg);
+	bool steal(unsigned int index, Msg &msg);
+	void notify();
+	void invokeDispatcher(const PStreamEventDispatcher &sed);
+
+	static thread_local WorkStealing *curExecutor;
+	static thread_local unsigned int curIndex;
+	static thread_local unsigned int rndState;
+};
+
+thread_local ThreadPoolAsyncImpl::WorkStealing *ThreadPoolAsyncImpl::WorkStealing::curExecutor = nullptr;
+thread_local unsigned int ThreadPoolAsyncImpl::WorkStealing::curIndex = 0;
+thread_local unsigned int ThreadPoolAsyncImpl::WorkStealing::rndState = 0;
+
+ThreadPoolAsyncImpl::WorkStealing::WorkStealing(unsigned int threads, const std::vector<PStreamEventDispatcher> &dispatchers)
+	:dispatchers(dispatchers)
+	,activeDispatchers(static_cast<unsigned int>(dispatchers.size()))
+	,rrCounter(0)
+	,epoch(0)
+	,sleepers(0)
+{
+	for (unsigned int i = 0; i < threads; i++) {
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue));
+	}
+	for (std::size_t i = 0; i < dispatchers.size(); i++) {
+		PStreamEventDispatcher sed = dispatchers[i];
+		pushTo(i % threads, [this, sed]{invokeDispatcher(sed);});
+	}
+}
+
+void ThreadPoolAsyncImpl::WorkStealing::pushTo(unsigned int index, Msg &&msg) {
+	WorkQueue &wq = *queues[index];
+	{
+		std::lock_guard<std::mutex> _(wq.lock);
+		wq.q.push_back(std::move(msg));
+	}
+	notify();
+}
+
+void ThreadPoolAsyncImpl::WorkStealing::push(Msg &&msg) {
+	if (curExecutor == this) pushTo(curIndex, std::move(msg));
+	else selectDispatcher()->runAsync(std::move(msg));
+}
+
+void ThreadPoolAsyncImpl::WorkStealing::notify() {
+	++epoch;
+	if (sleepers.load()) {
+		std::lock_guard<std::mutex> _(sleepLock);
+		sleepCond.notify_one();
+	}
+}
+
+const PStreamEventDispatcher &ThreadPoolAsyncImpl::WorkStealing::selectDispatcher() {
+	if (curExecutor == this) return dispatchers[curIndex % dispatchers.size()];
+	else return dispatchers[rrCounter++ % dispatchers.size()];
+}
+
+bool ThreadPoolAsyncImpl::WorkStealing::popLocal(unsigned int index, Msg &msg) {
+	WorkQueue &wq = *queues[index];
+	std::lock_guard<std::mutex> _(wq.lock);
+	if (wq.q.empty()) return false;
+	msg = std::move(wq.q.back());
+	wq.q.pop_back();
+	return true;
+}
+
+bool ThreadPoolAsyncImpl::WorkStealing::steal(unsigned int index, Msg &msg) {
+	unsigned int cnt = static_cast<unsigned int>(queues.size());
+	//xorshift
+	rndState ^= rndState << 13;
+	rndState ^= rndState >> 17;
+	rndState ^= rndState << 5;
+	unsigned int start = rndState % cnt;
+	for (unsigned int i = 0; i < cnt; i++) {
+		unsigned int v = (start + i) % cnt;
+		if (v == index) continue;
+		WorkQueue &wq = *queues[v];
+		std::lock_guard<std::mutex> _(wq.lock);
+		if (!wq.q.empty()) {
+			msg = std::move(wq.q.front());
+			wq.q.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPoolAsyncImpl::WorkStealing::invokeDispatcher(const PStreamEventDispatcher &sed) {
+	auto t = sed->wait();
+	if (t == nullptr) {
+		--activeDispatchers;
+		++epoch;
+		std::lock_guard<std::mutex> _(sleepLock);
+		sleepCond.notify_all();
+		return;
+	}
+	//let other thread to wait on dispatcher while the completion is processed here
+	PStreamEventDispatcher cp(sed);
+	pushTo(curIndex, [this, cp]{invokeDispatcher(cp);});
+	t();
+}
+
+void ThreadPoolAsyncImpl::WorkStealing::run(unsigned int index) noexcept {
+	curExecutor = this;
+	curIndex = index;
+	rndState = index * 2654435761U + 1;
+	Msg msg;
+	for(;;) {
+		unsigned int seen = epoch.load();
+		if (popLocal(index, msg) || steal(index, msg)) {
+			msg();
+			msg = nullptr;
+			continue;
+		}
+		if (activeDispatchers.load() == 0) break;
+		std::unique_lock<std::mutex> lk(sleepLock);
+		++sleepers;
+		sleepCond.wait(lk, [&]{return epoch.load() != seen;});
+		--sleepers;
+	}
+	curExecutor = nullptr;
+}
+
+
 ThreadPoolAsyncImpl::~ThreadPoolAsyncImpl() {
     ThreadPoolAsyncImpl::stop();
 }
@@ -106,6 +274,35 @@ PStreamEventDispatcher ThreadPoolAsyncImpl::getListener() {
 }
 
 
+ThreadPoolAsyncImpl::WorkStealing &ThreadPoolAsyncImpl::getWorkStealing() {
+	std::call_once(wsInit, [&]{
+		Sync _(lock);
+		unsigned int dcnt = reqDispatcherCount?reqDispatcherCount:1;
+		unsigned int tcnt = reqThreadCount < dcnt?dcnt:reqThreadCount;
+		std::vector<PStreamEventDispatcher> dispatchers;
+		for (unsigned int i = 0; i < dcnt; i++) {
+			PStreamEventDispatcher d = AbstractStreamEventDispatcher::create();
+			dispatchers.push_back(d);
+			cQueue.push(d);
+		}
+		ws = std::unique_ptr<WorkStealing>(new WorkStealing(tcnt, dispatchers));
+		RefCntPtr<ThreadPoolAsyncImpl> me(this);
+		for (unsigned int i = 0; i < tcnt; i++) {
+			threadCount.inc();
+			runThread([me, i] {
+				me->ws->run(i);
+				me->threadCount.dec();
+			});
+		}
+	});
+	return *ws;
+}
+
+void ThreadPoolAsyncImpl::setExecutorMode(ExecutorMode mode) {
+	Sync _(lock);
+	if (ws == nullptr) executorMode = mode;
+}
+
 void ThreadPoolAsyncImpl::runAsync(const AsyncResource& resource, int timeout,  CompletionFn &&fn) {
 
 	if (exitFlag) {
@@ -113,6 +310,11 @@ void ThreadPoolAsyncImpl::runAsync(const AsyncResource& resource, int timeout,
 		return;
 	}
 
+	if (executorMode == workStealing) {
+		getWorkStealing().selectDispatcher()->runAsync(resource, timeout, std::move(fn));
+		return;
+	}
+
 	unsigned int tries = 0;
 	auto retry = [&] {
 		Sync _(lock);
@@ -205,6 +407,20 @@ AsyncProvider ThreadPoolAsync::create(unsigned int numThreads, unsigned int numL
 	return provider;
 }
 
+AsyncProvider ThreadPoolAsync::createWorkStealing(unsigned int numThreads, unsigned int numDispatchers) {
+	if (numThreads == 0) numThreads = std::thread::hardware_concurrency();
+	if (numThreads == 0) numThreads = 1;
+	ThreadPoolAsync provider (new ThreadPoolAsyncImpl);
+	provider.setExecutorMode(ThreadPoolAsyncImpl::workStealing);
+	provider.setCountOfDispatchers(numDispatchers);
+	provider.setCountOfThreads(numThreads);
+	return provider;
+}
+
+void ThreadPoolAsync::setExecutorMode(ThreadPoolAsyncImpl::ExecutorMode mode) {
+	(*this)->setExecutorMode(mode);
+}
+
 void ThreadPoolAsync::setCountOfDispatchers(unsigned int count) {
 	(*this)->setCountOfDispatchers(count);
 }
@@ -230,6 +446,11 @@ void ThreadPoolAsyncImpl::runAsync(CustomFn&& completion) {
 		return;
 	}
 
+	if (executorMode == workStealing) {
+		getWorkStealing().push(std::move(completion));
+		return;
+	}
+
 	if (reqThreadCount > reqDispatcherCount) {
 		checkThreadCount();
 		dQueue.dispatch(std::move(completion));
@@ -239,6 +460,37 @@ void ThreadPoolAsyncImpl::runAsync(CustomFn&& completion) {
 	}
 }
 
+void ThreadPoolAsyncImpl::runAfter(int ms, CustomFn&& completion) {
+
+	if (exitFlag) {
+		completion();
+		return;
+	}
+
+	if (executorMode == workStealing) {
+		getWorkStealing().selectDispatcher()->runAfter(ms, std::move(completion));
+		return;
+	}
+
+	auto lst = getListener();
+	lst->runAfter(ms, std::move(completion));
+}
+
+bool ThreadPoolAsyncImpl::runAsyncIO(IOOperation op, const AsyncResource &resource, void *buffer, std::size_t size, int timeout, IOCompletionFn &&complfn) {
+
+	if (exitFlag) {
+		complfn(asyncCancel, 0);
+		return true;
+	}
+
+	if (executorMode == workStealing) {
+		return getWorkStealing().selectDispatcher()->runAsyncIO(op, resource, buffer, size, timeout, std::move(complfn));
+	}
+
+	auto lst = getListener();
+	return lst->runAsyncIO(op, resource, buffer, size, timeout, std::move(complfn));
+}
+
 void ThreadPoolAsync::setTasksPerDispLimit(unsigned int count) {
 	(*this)->setTasksPerDispLimit(count);
 }
@@ -1,6 +1,10 @@
 
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <queue>
+
 #include "asyncProvider.h"
 #include "shared/msgqueue.h"
 #include "shared/countdown.h"
@@ -23,12 +27,33 @@ public:
 
 	virtual void runAsync(CustomFn &&completion) override;
 
+	virtual void runAfter(int ms, CustomFn &&completion) override;
+
+	virtual bool runAsyncIO(IOOperation op, const AsyncResource &resource, void *buffer, std::size_t size, int timeout, IOCompletionFn &&complfn) override;
+
 	virtual void stop() override;
 
 	virtual void cancel(const AsyncResource &resource) override;
 
 public:
 
+	///Selects, how tasks are distributed between threads
+	enum ExecutorMode {
+		///all threads share single queue (default)
+		sharedQueue,
+		///every thread has own queue
+		/** Tasks created by a thread of the pool are pushed to the queue of that thread and
+		 * processed in LIFO order, so they stay on the thread while it is busy. Idle threads steal
+		 * the oldest tasks from queues of randomly chosen threads. Count of threads and dispatchers
+		 * is fixed once the pool starts.
+		 */
+		workStealing
+	};
+
+	///Sets executor mode
+	/** Must be called before the first asynchronous operation, otherwise it is ignored */
+	void setExecutorMode(ExecutorMode mode);
+
 	void setCountOfDispatchers(unsigned int count);
 
 	void setCountOfThreads(unsigned int count);
@@ -50,6 +75,13 @@ protected:
 	std::queue<PStreamEventDispatcher> cQueue;
 	std::mutex lock;
 	typedef std::lock_guard<std::mutex> Sync;
+	ExecutorMode executorMode = sharedQueue;
+
+	class WorkStealing;
+	std::unique_ptr<WorkStealing> ws;
+	std::once_flag wsInit;
+
+	WorkStealing &getWorkStealing();
 
 
 	PStreamEventDispatcher getListener();
@@ -86,6 +118,16 @@ public:
 	 * Never assume that single-threaded pool can alvays stay single-threaded.
 	 */
 	static AsyncProvider create(unsigned int numThreads=1, unsigned int numDispatchers=1, unsigned int tasksPerDispLimit=60);
+	///Creates thread pool which uses work stealing executor
+	/**
+	 * @param numThreads count of threads. Set 0 to create one thread per CPU
+	 * @param numDispatchers count of dispatchers
+	 *
+	 * @see ThreadPoolAsyncImpl::workStealing
+	 */
+	static AsyncProvider createWorkStealing(unsigned int numThreads=0, unsigned int numDispatchers=1);
+	///Sets executor mode. Must be called before the pool is used
+	void setExecutorMode(ThreadPoolAsyncImpl::ExecutorMode mode);
 	///Changes count of dispatchers
 	/** @param count desired count of dispatchers
 	 *
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace simpleServer {
+
+
+///Hierarchical timing wheel
+/**
+ * Keeps timers with millisecond resolution. Adding and removing a timer costs O(1). Expiration
+ * costs O(1) per timer amortized (a timer can be moved between levels at most once per level).
+ * Time spent without expiring timers costs nothing, the wheel jumps directly to
+ * the next occupied slot.
+ *
+ * The wheel has 6 levels by 256 slots. The slot of the timer is selected by comparing its
+ * expiration with the current time. The level is the highest byte in which these times differ,
+ * and the slot is the value of that byte in the expiration time. Once the current time reaches
+ * the slot, the timers are moved to the lower levels.
+ *
+ * Object is not MT safe. It is intended to be used inside of a dispatcher's thread
+ *
+ * @tparam T payload stored with the timer. It is moved out when the timer expires
+ */
+template<typename T>
+class TimerWheel {
+public:
+
+	typedef std::chrono::steady_clock Clock;
+	typedef Clock::time_point TimePoint;
+	///Identifies timer in the wheel
+	typedef unsigned int TimerID;
+
+	///Contains ID which is never used by a timer
+	static constexpr TimerID noTimer = static_cast<TimerID>(-1);
+
+	TimerWheel(TimePoint epoch = Clock::now()):epoch(epoch) {
+		for (auto &x: heads) x = noTimer;
+		for (auto &x: bitmap) x = 0;
+	}
+
+	///Adds timer
+	/**
+	 * @param expiration time of expiration. If the time is in past, the timer expires on next
+	 * call of the function advance()
+	 * @param payload payload of the timer
+	 * @return ID of timer. It is valid until the timer expires or until it is removed
+	 */
+	TimerID add(const TimePoint &expiration, T &&payload) {
+		TimerID id;
+		if (freeList != noTimer) {
+			id = freeList;
+			freeList = nodes[id].next;
+			nodes[id].payload = std::move(payload);
+		} else {
+			id = static_cast<TimerID>(nodes.size());
+			nodes.push_back(Node(std::move(payload)));
+		}
+		std::uint64_t t = toTick(expiration);
+		if (t <= cur) t = cur+1;
+		nodes[id].tick = t;
+		link(id);
+		++count;
+		return id;
+	}
+
+	///Removes timer
+	/**
+	 * @param id ID of timer
+	 * @return payload of the timer
+	 */
+	T remove(TimerID id) {
+		unlink(id);
+		--count;
+		return release(id);
+	}
+
+	///Returns payload of the timer
+	T &operator[](TimerID id) {return nodes[id].payload;}
+	///Returns payload of the timer
+	const T &operator[](TimerID id) const {return nodes[id].payload;}
+
+	///Returns true, if there is no timer
+	bool empty() const {return count == 0;}
+	///Returns count of timers
+	std::size_t size() const {return count;}
+
+	///Returns time when the wheel should be advanced
+	/**
+	 * @return time when the nearest timer expires or earlier time when the wheel needs to
+	 * reorganize its timers. Function returns TimePoint::max() when the wheel is empty
+	 */
+	TimePoint nextExpiration() const {
+		if (count == 0) return TimePoint::max();
+		std::uint64_t e = nextEventTick();
+		if (e == ~std::uint64_t(0)) return TimePoint::max();
+		return epoch + std::chrono::milliseconds(e);
+	}
+
+	///Advances time and expires timers
+	/**
+	 * @param now current time
+	 * @param fn function called for every expired timer with its payload (as rvalue). The function
+	 * can add or remove other timers
+	 */
+	template<typename Fn>
+	void advance(const TimePoint &now, Fn &&fn) {
+		std::uint64_t target = now <= epoch?0:static_cast<std::uint64_t>(
+				std::chrono::duration_cast<std::chrono::milliseconds>(now - epoch).count());
+		while (cur < target && count) {
+			std::uint64_t e = nextEventTick();
+			if (e > target) break;
+			std::uint64_t prev = cur;
+			cur = e;
+			for (unsigned int l = levels-1; l > 0; --l) {
+				if (byteAt(prev, l) != byteAt(cur, l)) cascade(l*slots+byteAt(cur,l));
+			}
+			unsigned int b = byteAt(cur, 0);
+			while (heads[b] != noTimer) {
+				TimerID id = heads[b];
+				unlink(id);
+				--count;
+				fn(release(id));
+			}
+		}
+		if (cur < target) cur = target;
+	}
+
+	///Removes all timers
+	/**
+	 * @param fn function called for every timer with its payload (as rvalue)
+	 */
+	template<typename Fn>
+	void clear(Fn &&fn) {
+		for (unsigned int i = 0; i < levels*slots; i++) {
+			while (heads[i] != noTimer) {
+				TimerID id = heads[i];
+				unlink(id);
+				--count;
+				fn(release(id));
+			}
+		}
+	}
+
+protected:
+
+	static constexpr unsigned int levels = 6;
+	static constexpr unsigned int slots = 256;
+	static constexpr unsigned int slotBits = 8;
+	static constexpr unsigned int wordsPerLevel = slots/64;
+
+	struct Node {
+		T payload;
+		std::uint64_t tick = 0;
+		TimerID prev = noTimer;
+		TimerID next = noTimer;
+		unsigned int bucket = 0;
+
+		Node(T &&payload):payload(std::move(payload)) {}
+	};
+
+	TimePoint epoch;
+	///last processed tick (all timers up to this tick are expired)
+	std::uint64_t cur = 0;
+	std::size_t count = 0;
+	std::vector<Node> nodes;
+	TimerID freeList = noTimer;
+	TimerID heads[levels*slots];
+	///contains bit for every non-empty slot
+	std::uint64_t bitmap[levels*wordsPerLevel];
+
+	static unsigned int byteAt(std::uint64_t tick, unsigned int level) {
+		return static_cast<unsigned int>(tick >> (level*slotBits)) & (slots-1);
+	}
+
+	std::uint64_t toTick(const TimePoint &tp) const {
+		if (tp <= epoch) return 0;
+		if (tp == TimePoint::max()) return ~std::uint64_t(0);
+		auto d = std::chrono::duration_cast<std::chrono::milliseconds>(tp - epoch).count();
+		//round up, timer must not expire before its time
+		if (epoch + std::chrono::milliseconds(d) < tp) ++d;
+		return static_cast<std::uint64_t>(d);
+	}
+
+	void link(TimerID id) {
+		Node &n = nodes[id];
+		std::uint64_t diff = n.tick ^ cur;
+		unsigned int l = 0;
+		while (l < levels-1 && (diff >> ((l+1)*slotBits)) != 0) ++l;
+		//timers too far in the future are kept in the last slot of top level
+		unsigned int s = (diff >> (l*slotBits)) >= slots?slots-1:byteAt(n.tick, l);
+		n.bucket = l*slots+s;
+		n.prev = noTimer;
+		n.next = heads[n.bucket];
+		if (n.next != noTimer) nodes[n.next].prev = id;
+		heads[n.bucket] = id;
+		bitmap[n.bucket/64] |= std::uint64_t(1) << (n.bucket%64);
+	}
+
+	void unlink(TimerID id) {
+		Node &n = nodes[id];
+		if (n.prev != noTimer) nodes[n.prev].next = n.next;
+		else heads[n.bucket] = n.next;
+		if (n.next != noTimer) nodes[n.next].prev = n.prev;
+		if (heads[n.bucket] == noTimer) {
+			bitmap[n.bucket/64] &= ~(std::uint64_t(1) << (n.bucket%64));
+		}
+	}
+
+	T release(TimerID id) {
+		T p = std::move(nodes[id].payload);
+		nodes[id].payload = T();
+		nodes[id].next = freeList;
+		freeList = id;
+		return p;
+	}
+
+	void cascade(unsigned int bucket) {
+		TimerID id = heads[bucket];
+		if (id == noTimer) return;
+		heads[bucket] = noTimer;
+		bitmap[bucket/64] &= ~(std::uint64_t(1) << (bucket%64));
+		while (id != noTimer) {
+			TimerID nx = nodes[id].next;
+			link(id);
+			id = nx;
+		}
+	}
+
+	///finds first non-empty slot of the level after the position of current time
+	int findSlot(unsigned int level, unsigned int from) const {
+		const std::uint64_t *w = bitmap+level*wordsPerLevel;
+		for (unsigned int i = from/64; i < wordsPerLevel; i++) {
+			std::uint64_t m = w[i];
+			if (i == from/64) m &= ~std::uint64_t(0) << (from%64);
+			if (m) return static_cast<int>(i*64+__builtin_ctzll(m));
+		}
+		return -1;
+	}
+
+	///returns tick when the next slot must be processed
+	std::uint64_t nextEventTick() const {
+		for (unsigned int l = 0; l < levels; l++) {
+			unsigned int b = byteAt(cur, l);
+			if (b == slots-1) continue;
+			int s = findSlot(l, b+1);
+			if (s >= 0) {
+				unsigned int shift = l*slotBits;
+				std::uint64_t upper = shift+slotBits >= 64?0:(cur >> (shift+slotBits)) << (shift+slotBits);
+				return upper | (static_cast<std::uint64_t>(s) << shift);
+			}
+		}
+		//only timers beyond range of the wheel
+		return ~std::uint64_t(0);
+	}
+
+};
+
+
+}
@@ -0,0 +1,133 @@
+/*
+ * httpbench.cpp
+ *
+ * Compares throughput and latency of MiniHttpServer in thread pool mode and in
+ * thread per core mode. Both the server and the clients run in this process.
+ *
+ * usage: httpbench [pool|core] [connections] [seconds] [threads] [poll|epoll|epolledge|uring]
+ */
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../simpleServer/http_server.h"
+#include "../simpleServer/tcp.h"
+
+using namespace simpleServer;
+
+typedef std::chrono::steady_clock Clock;
+
+static const char request[] = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+///Runs keep-alive client, collects latency of every request in microseconds
+static void runClient(unsigned int port, std::atomic<bool> &stopFlag, std::vector<unsigned int> &latencies) {
+	int s = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	sockaddr_in sin;
+	std::memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(s, reinterpret_cast<sockaddr *>(&sin), sizeof(sin)) != 0) {
+		close(s);
+		return;
+	}
+	std::string resp;
+	char buff[4096];
+	while (!stopFlag) {
+		auto start = Clock::now();
+		if (send(s, request, sizeof(request)-1, 0) != sizeof(request)-1) break;
+		//response has fixed length body, wait for whole response
+		resp.clear();
+		std::size_t need = std::string::npos;
+		while (resp.size() < need) {
+			int r = recv(s, buff, sizeof(buff), 0);
+			if (r <= 0) {close(s);return;}
+			resp.append(buff, r);
+			auto hdrEnd = resp.find("\r\n\r\n");
+			if (hdrEnd != resp.npos && need == std::string::npos) {
+				auto cl = resp.find("Content-Length: ");
+				std::size_t len = cl < hdrEnd?std::stoul(resp.substr(cl+16)):0;
+				need = hdrEnd+4+len;
+			}
+		}
+		auto dur = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+		latencies.push_back(static_cast<unsigned int>(dur.count()));
+	}
+	close(s);
+}
+
+int main(int argc, char **argv) {
+	std::string mode = argc > 1?argv[1]:"core";
+	unsigned int connections = argc > 2?std::stoul(argv[2]):64;
+	unsigned int seconds = argc > 3?std::stoul(argv[3]):5;
+	unsigned int threads = argc > 4?std::stoul(argv[4]):0;
+	std::string backend = argc > 5?argv[5]:"epoll";
+
+	if (backend == "poll") AbstractStreamEventDispatcher::setDefaultBackend(AbstractStreamEventDispatcher::backendPoll);
+	else if (backend == "epolledge") AbstractStreamEventDispatcher::setDefaultBackend(AbstractStreamEventDispatcher::backendEpollEdge);
+	else if (backend == "uring") AbstractStreamEventDispatcher::setDefaultBackend(AbstractStreamEventDispatcher::backendIoUring);
+
+	NetAddr addr = NetAddr::create("127.0.0.1",0);
+	std::unique_ptr<MiniHttpServer> server;
+	unsigned int port;
+	if (mode == "pool") {
+		StreamFactory sf = TCPListen::create(addr, -1, 30000);
+		port = std::stoul(TCPStreamFactory::getLocalAddress(sf).toString(false).substr(10));
+		server.reset(new MiniHttpServer(sf, threads, threads?threads:1));
+	} else {
+		//the first shard selects random port, find it out through a dedicated listener
+		StreamFactory probe = TCPListen::create(addr, -1, 30000);
+		port = std::stoul(TCPStreamFactory::getLocalAddress(probe).toString(false).substr(10));
+		probe.stop();
+		probe = nullptr;
+		MiniHttpServer::ThreadPerCore cfg;
+		cfg.cores = threads;
+		server.reset(new MiniHttpServer(NetAddr::create("127.0.0.1",port), cfg));
+	}
+
+	(*server) >> [](const HTTPRequest &req) {
+		req.sendResponse("text/plain","Hello world");
+	};
+
+	std::atomic<bool> stopFlag(false);
+	std::vector<std::vector<unsigned int> > latencies(connections);
+	std::vector<std::thread> clients;
+	auto start = Clock::now();
+	for (unsigned int i = 0; i < connections; i++) {
+		clients.push_back(std::thread([&,i]{runClient(port, stopFlag, latencies[i]);}));
+	}
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	stopFlag = true;
+	for (auto &&t: clients) t.join();
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::vector<unsigned int> all;
+	for (auto &&l: latencies) all.insert(all.end(), l.begin(), l.end());
+	if (all.empty()) {
+		std::cerr << "No request completed" << std::endl;
+		return 1;
+	}
+	std::sort(all.begin(), all.end());
+	std::cout << "mode: " << mode
+			  << ", backend: " << backend
+			  << ", connections: " << connections
+			  << ", requests: " << all.size()
+			  << ", req/s: " << static_cast<std::size_t>(all.size()/elapsed)
+			  << ", p50: " << all[all.size()/2] << "us"
+			  << ", p99: " << all[all.size()*99/100] << "us"
+			  << ", max: " << all.back() << "us" << std::endl;
+	return 0;
+}
@@ -14,6 +14,7 @@
 #include <mutex>
 #include "../simpleServer/tcp.h"
 #include "../simpleServer/threadPoolAsync.h"
+#include "../simpleServer/singleThreadAsync.h"
 #include "../simpleServer/mtcounter.h"
 #include "../simpleServer/http_parser.h"
 #include "../simpleServer/http_server.h"
@@ -200,6 +201,31 @@ int main(int argc, char *argv[]) {
 		Stream con2 = *server.begin();
 		if (con2 != nullptr) out << "ok";
 	};
+	tst.test("Listener.sharded","ok") >> [](std::ostream &out) {
+		std::vector<StreamFactory> shards = TCPListen::createSharded(NetAddr::create("127.0.0.1",0),4);
+		NetAddr srvAddr = TCPStreamFactory::getLocalAddress(shards[0]);
+		for (auto &&x: shards) {
+			if (TCPStreamFactory::getLocalAddress(x).toString(false) != srvAddr.toString(false)) {
+				out << "port mismatch";
+				return;
+			}
+		}
+		std::vector<AsyncProvider> providers;
+		MTCounter event(8);
+		for (auto &&x: shards) {
+			AsyncProvider p = ThreadPoolAsync::create(1,1,-1);
+			providers.push_back(p);
+			x->runServerAsync(p, [&](AsyncState st, Stream s){
+				if (st == asyncOK && s != nullptr) event.dec();
+			});
+		}
+		std::vector<Stream> conns;
+		for (int i = 0; i < 8; i++) conns.push_back(tcpConnect(srvAddr,30000));
+		event.zeroWait();
+		for (auto &&x: shards) x.stop();
+		for (auto &&x: providers) x.stop();
+		out << "ok";
+	};
 
 	tst.test("Listener.receiveMsg","test message") >> [](std::ostream &out) {
 		StreamFactory server = TCPListen::create(true,0);
@@ -219,6 +245,50 @@ int main(int argc, char *argv[]) {
 		}
 	};
 
+	tst.test("Listener.writeVector","header:test message:8192") >> [](std::ostream &out) {
+		StreamFactory server = TCPListen::create(true,0);
+		NetAddr srvAddr = TCPStreamFactory::getLocalAddress(server);
+		runThread([srvAddr] {
+			Stream con = tcpConnect(srvAddr,30000);
+			std::string big(8192,'x');
+			con.write(BinaryView(StrViewA("header:")),writeWholeBuffer);
+			BinaryView parts[] = {BinaryView(StrViewA("test ")),BinaryView(StrViewA("message:")),BinaryView(StrViewA(big))};
+			con.writeVector(parts,3,writeAndFlush);
+			con.writeEof();
+		});
+		Stream con2 = server();
+		std::string res;
+		BinaryView data = con2.read(false);
+		while (!data.empty()) {
+			res.append(reinterpret_cast<const char *>(data.data), data.length);
+			data = con2.read();
+		}
+		std::size_t sep = res.rfind(':')+1;
+		out << res.substr(0,sep) << res.length()-sep;
+	};
+
+	tst.test("Listener.sendFile","1:message") >> [](std::ostream &out) {
+		char fname[] = "/tmp/simpleServerTestXXXXXX";
+		int fd = mkstemp(fname);
+		unlink(fname);
+		if (::write(fd, "test message", 12) != 12) return;
+		StreamFactory server = TCPListen::create(true,0);
+		NetAddr srvAddr = TCPStreamFactory::getLocalAddress(server);
+		runThread([srvAddr,fd] {
+			Stream con = tcpConnect(srvAddr,30000);
+			con.sendFile(fd,5,100,writeAndFlush);
+			con.writeEof();
+			close(fd);
+		});
+		Stream con2 = server();
+		out << con2.canSendFile() << ":";
+		BinaryView data = con2.read(false);
+		while (!data.empty()) {
+			out << StrViewA(data);
+			data = con2.read();
+		}
+	};
+
 	tst.test("Listener.async.receiveMsg","test message") >> [](std::ostream &out) {
 		StreamFactory server = TCPListen::create(true,0);
 		NetAddr srvAddr = TCPStreamFactory::getLocalAddress(server);
@@ -239,6 +309,50 @@ int main(int argc, char *argv[]) {
 		event.zeroWait();
 		async.stop();
 	};
+	tst.test("Listener.async.ioUring","test message") >> [](std::ostream &out) {
+		StreamFactory server = TCPListen::create(true,0);
+		NetAddr srvAddr = TCPStreamFactory::getLocalAddress(server);
+		//falls back to epoll, when io_uring is not available
+		AbstractStreamEventDispatcher::setDefaultBackend(AbstractStreamEventDispatcher::backendIoUring);
+		AsyncProvider async = SingleThreadAsync::create();
+		AbstractStreamEventDispatcher::setDefaultBackend(AbstractStreamEventDispatcher::backendDefault);
+		MTCounter event(1);
+
+		server(async, [&](AsyncState, Stream s){
+			if (s != nullptr) {
+				s.readAsync(AsyncReader(s,out,event));
+			}
+		});
+		Stream s = tcpConnect(srvAddr,30000);
+		StrViewA msg("test message");
+		s.write(BinaryView(msg));
+		s.closeOutput();
+		event.zeroWait();
+		async.stop();
+	};
+	tst.test("Async.runAfter","321") >> [](std::ostream &out) {
+		AsyncProvider async = ThreadPoolAsync::create();
+		MTCounter event(3);
+		std::mutex mx;
+		async.runAfter(300, [&]{std::lock_guard<std::mutex> _(mx);out << "1";event.dec();});
+		async.runAfter(200, [&]{std::lock_guard<std::mutex> _(mx);out << "2";event.dec();});
+		async.runAfter(100, [&]{std::lock_guard<std::mutex> _(mx);out << "3";event.dec();});
+		event.zeroWait();
+		async.stop();
+	};
+	tst.test("Async.workStealing","10100") >> [](std::ostream &out) {
+		AsyncProvider async = ThreadPoolAsync::createWorkStealing(4,1);
+		MTCounter event(10100);
+		for (int i = 0; i < 100; i++) {
+			async.runAsync([&,async]{
+				for (int j = 0; j < 100; j++) async.runAsync([&]{event.dec();});
+				event.dec();
+			});
+		}
+		event.zeroWait();
+		async.stop();
+		out << 10100 - event.getCounter();
+	};
 
 /*
 	tst.test("Http.server1","") >> [](std::ostream &out) {